@@ -9,6 +9,8 @@
 // * To get a buffer for a particular disk block, call bread.
 // * After changing buffer data, call bwrite to write it to disk.
 // * When done with the buffer, call brelse.
+// * For file data, which the page cache keeps, call bdrop
+//     instead, so that it is the first to be recycled.
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
 //     so do not keep them longer than necessary.
@@ -22,6 +24,7 @@
 #include "defs.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 struct {
   struct spinlock lock;
@@ -96,6 +99,7 @@ bread(uint dev, uint blockno)
 
   b = bget(dev, blockno);
   if(!b->valid) {
+    TRACE(TE_BREADMISS, dev, blockno);
     virtio_disk_rw(b, 0);
     b->valid = 1;
   }
@@ -108,6 +112,7 @@ bwrite(struct buf *b)
 {
   if(!holdingsleep(&b->lock))
     panic("bwrite");
+  TRACE(TE_BWRITE, b->dev, b->blockno);
   virtio_disk_rw(b, 1);
 }
 
@@ -136,6 +141,30 @@ brelse(struct buf *b)
   release(&bcache.lock);
 }
 
+// Release a locked buffer holding file data.
+// Move to the tail of the list, so that reading a large file
+// does not push metadata out of the cache.
+void
+bdrop(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("bdrop");
+
+  releasesleep(&b->lock);
+
+  acquire(&bcache.lock);
+  b->refcnt--;
+  if (b->refcnt == 0) {
+    b->next->prev = b->prev;
+    b->prev->next = b->next;
+    b->next = &bcache.head;
+    b->prev = bcache.head.prev;
+    bcache.head.prev->next = b;
+    bcache.head.prev = b;
+  }
+  release(&bcache.lock);
+}
+
 void
 bpin(struct buf *b) {
   acquire(&bcache.lock);
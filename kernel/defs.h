@@ -2,17 +2,23 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct kmem_cache;
 struct pipe;
 struct proc;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct vma;
+struct vmwalk;
+struct wsinfo;
+struct perfinfo;
 
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
 void            brelse(struct buf*);
+void            bdrop(struct buf*);
 void            bwrite(struct buf*);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
@@ -23,7 +29,8 @@ void            consoleintr(int);
 void            consputc(int);
 
 // exec.c
-int             exec(char*, char**);
+int             exec(char*, char*, int, int);
+int             execproc(struct proc*, char*, char*, int, int);
 
 // file.c
 struct file*    filealloc(void);
@@ -52,6 +59,7 @@ struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, int, uint64, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, int, uint64, uint, uint);
+uint            bmap(struct inode*, uint);
 void            itrunc(struct inode*);
 
 // ramdisk.c
@@ -62,6 +70,12 @@ void            ramdiskrw(struct buf*);
 // kalloc.c
 void*           kalloc(void);
 void            kfree(void *);
+void*           kalloc_order(int);
+void            kfree_order(void *, int);
+void            kdup(void *);
+void            ksplit(void *, int);
+int             kref(void *);
+int             kallocstats(char*, int);
 void            kinit(void);
 
 // log.c
@@ -71,11 +85,19 @@ void            begin_op(void);
 void            end_op(void);
 
 // pipe.c
+void            pipeinit(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
 int             pipewrite(struct pipe*, uint64, int);
 
+// klog.c
+void            kloginit(void);
+void            klogputc(int);
+void            klogdrain(void);
+void            klogpanic(void);
+int             klogstats(char*, int);
+
 // printf.c
 void            printf(char*, ...);
 void            panic(char*) __attribute__((noreturn));
@@ -86,13 +108,18 @@ extern          pagetable_t kernel_pagetable;
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
-int             growproc(int);
+int             spawn(char*, char*, int, int, int*);
+int             clone(uint64, uint64, uint64);
+int             vmlock(struct proc*);
+void            vmunlock(struct proc*);
+void            tlbsync(struct proc*);
+uint64          growproc(int);
 void            proc_mapstacks(pagetable_t);
-void            proc_setstacks(pagetable_t, pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
 void            proc_free_kernel_pagetable(pagetable_t);
 int             kill(int);
+struct proc*    findproc(int);
 int             killed(struct proc*);
 void            setkilled(struct proc*);
 struct cpu*     mycpu(void);
@@ -109,6 +136,9 @@ void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
+int             getprocinfo(uint64, int);
+int             perfget(int, struct perfinfo*);
+int             cpustats(char*, int);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -120,6 +150,7 @@ void            initlock(struct spinlock*, char*);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
+int             cansleep(void);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
@@ -127,6 +158,57 @@ void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
+// slab.c
+void            kmem_cache_init(struct kmem_cache*, char*, uint);
+void*           kmem_cache_alloc(struct kmem_cache*);
+void            kmem_cache_free(struct kmem_cache*, void*);
+int             slabstats(char*, int);
+
+// sprintf.c
+int             snprintf(char*, int, char*, ...);
+
+// stats.c
+void            statsinit(void);
+
+// swap.c
+void            swapinit(uint, uint, uint);
+int             swapreclaim(void);
+void            swapin(pte_t, char*);
+void            swapdup(pte_t);
+void            swapfree(pte_t);
+int             swapstats(char*, int);
+
+// prof.c
+extern int      profrate;
+void            profinit(void);
+int             profintr(void);
+int             profile(int);
+int             profstats(char*, int);
+
+// trace.c
+extern uint     tracemask;
+void            traceinit(void);
+void            trace(int, uint64, uint64);
+int             settracemask(int);
+int             tracestats(char*, int);
+
+// futex.c
+void            futexinit(void);
+int             futexwait(uint64, int);
+int             futexwake(uint64, int);
+
+// wset.c
+void            wssample(struct proc*);
+int             wsget(int, struct wsinfo*);
+
+// pcache.c
+void            pcacheinit(void);
+void*           pcacheget(struct inode*, uint);
+void            pcacheupdate(struct inode*, uint, char*, uint);
+void            pcacheinval(struct inode*);
+int             pcachereclaim(void);
+int             pcachestats(char*, int);
+
 // string.c
 int             memcmp(const void*, const void*, uint);
 void*           memmove(void*, const void*, uint);
@@ -143,6 +225,7 @@ void            argaddr(int, uint64 *);
 int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
+int             syscallstat(uint64, int);
 
 // trap.c
 extern uint     ticks;
@@ -154,10 +237,22 @@ void            usertrapret(void);
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
-void            uartputc(int);
+void            uartwrite(char*, int);
+int             uarttrywrite(char*, int);
 void            uartputc_sync(int);
 int             uartgetc(void);
 
+// vma.c
+struct vma*     vmalookup(struct proc*, uint64);
+struct vma*     vmaoverlap(struct proc*, uint64, uint64);
+int             vmfault(struct proc*, uint64, int);
+int             vmprefault(struct proc*, uint64, uint64, int);
+uint64          vmmap(struct proc*, uint64, int, int, struct inode*, uint);
+int             vmunmap(struct proc*, uint64, uint64);
+void            vmunmapall(struct proc*);
+int             vmadup(struct proc*, struct proc*);
+void            vmaput(struct vma*);
+
 // vm.c
 pagetable_t     kvmmake(void);
 pagetable_t     user_kvmmake(void);
@@ -172,10 +267,16 @@ uint64          uvmdealloc(pagetable_t, uint64, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, uint64);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
+void            uvmunmapsync(pagetable_t, pagetable_t, uint64, uint64);
+int             uvmsplit(pagetable_t, uint64, int);
+void            uvmaccess(pagetable_t, uint64, int, uint64*);
 uint64          userkernel_unmap(pagetable_t, uint64, uint64);
 void            clear_pte(pagetable_t, uint64, uint64);
 void            uvmclear(pagetable_t, uint64);
 pte_t *         walk(pagetable_t, uint64, int);
+void            vmwalk_init(struct vmwalk*, pagetable_t, uint64, uint64, int);
+int             vmwalk_next(struct vmwalk*);
+int             vmwalk_descend(struct vmwalk*);
 uint64          walkaddr(pagetable_t, uint64);
 int             copyout(pagetable_t, uint64, char *, uint64);
 int             copyin(pagetable_t, char *, uint64, uint64);
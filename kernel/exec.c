@@ -7,7 +7,6 @@
 #include "defs.h"
 #include "elf.h"
 
-static int loadseg(pde_t *, uint64, struct inode *, uint, uint);
 
 int flags2perm(int flags)
 {
@@ -19,18 +18,27 @@ int flags2perm(int flags)
     return perm;
 }
 
+// Replace p's user image with the program at path, which
+// gets the arguments in args: argc nul-terminated strings
+// packed end to end, len bytes in all, preceded by ARGHDR
+// bytes of scratch space. p is the calling process, or one
+// that spawn() has allocated and that is not yet running.
 int
-exec(char *path, char **argv)
+execproc(struct proc *p, char *path, char *args, int argc, int len)
 {
   char *s, *last;
-  int i, off;
-  uint64 argc, sz = 0, sp, ustack[MAXARG], stackbase;
+  int i, off, nbytes, nvma = 0;
+  uint64 sz = 0, sp, *uargv, stackpages;
   struct elfhdr elf;
   struct inode *ip;
   struct proghdr ph;
+  struct vma vma[NVMA];
   pagetable_t pagetable = 0, oldpagetable;
   pagetable_t proc_kernel_pagetable = 0, old_proc_kernel_pagetable;
-  struct proc *p = myproc();
+
+  // the other threads would be left without memory.
+  if(p->mm != p || p->nthread > 1)
+    return -1;
 
   begin_op();
 
@@ -50,7 +58,9 @@ exec(char *path, char **argv)
   if((pagetable = proc_pagetable(p)) == 0)
     goto bad;
 
-  // Load program into memory.
+  // Record where each segment comes from in the file; its
+  // pages are read in by vmfault() when first touched.
+  memset(vma, 0, sizeof(vma));
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(readi(ip, 0, (uint64)&ph, off, sizeof(ph)) != sizeof(ph))
       goto bad;
@@ -62,56 +72,64 @@ exec(char *path, char **argv)
       goto bad;
     if(ph.vaddr % PGSIZE != 0)
       goto bad;
-    uint64 sz1;
-    if((sz1 = uvmalloc(pagetable, sz, ph.vaddr + ph.memsz, flags2perm(ph.flags))) == 0)
+    if(ph.vaddr < sz || ph.vaddr + ph.memsz >= PLIC)
       goto bad;
-    sz = sz1;
-    if(loadseg(pagetable, ph.vaddr, ip, ph.off, ph.filesz) < 0)
+    if(ph.memsz == 0)
+      continue;
+    if(nvma >= NVMA)
       goto bad;
+    vma[nvma].start = ph.vaddr;
+    vma[nvma].end = PGROUNDUP(ph.vaddr + ph.memsz);
+    vma[nvma].perm = PTE_R | flags2perm(ph.flags);
+    vma[nvma].ip = idup(ip);
+    vma[nvma].off = ph.off;
+    vma[nvma].filesz = ph.filesz;
+    nvma++;
+    sz = ph.vaddr + ph.memsz;
   }
   iunlockput(ip);
   end_op();
   ip = 0;
 
-  p = myproc();
   uint64 oldsz = p->sz;
 
-  // Allocate two pages at the next page boundary.
-  // Make the first inaccessible as a stack guard.
-  // Use the second as the user stack.
+  // The top of the stack holds the argv[] pointers followed
+  // by the strings they point to; build that image in args,
+  // just before the strings.
+  if(argc > MAXARG)
+    goto bad;
+  nbytes = (argc+1)*sizeof(uint64) + len;
+  uargv = (uint64*)(args + ARGHDR) - (argc+1);
+
+  // Allocate a guard page and the user stack at the next page
+  // boundary. The stack is one page, unless the arguments need
+  // more, in which case it gets an extra page for the program.
+  if(nbytes <= PGSIZE)
+    stackpages = 1;
+  else
+    stackpages = PGROUNDUP(nbytes)/PGSIZE + 1;
   sz = PGROUNDUP(sz);
   uint64 sz1;
-  if((sz1 = uvmalloc(pagetable, sz, sz + 2*PGSIZE, PTE_W)) == 0)
+  if((sz1 = uvmalloc(pagetable, sz, sz + (stackpages+1)*PGSIZE, PTE_W)) == 0)
     goto bad;
 
   if (sz1 >= PLIC)
     goto bad;
 
   sz = sz1;
-  uvmclear(pagetable, sz-2*PGSIZE);
-  sp = sz;
-  stackbase = sp - PGSIZE;
-
-  // Push argument strings, prepare rest of stack in ustack.
-  for(argc = 0; argv[argc]; argc++) {
-    if(argc >= MAXARG)
-      goto bad;
-    sp -= strlen(argv[argc]) + 1;
-    sp -= sp % 16; // riscv sp must be 16-byte aligned
-    if(sp < stackbase)
-      goto bad;
-    if(copyout(pagetable, sp, argv[argc], strlen(argv[argc]) + 1) < 0)
-      goto bad;
-    ustack[argc] = sp;
+  uvmclear(pagetable, sz-(stackpages+1)*PGSIZE);
+  sp = sz - nbytes;
+  sp -= sp % 16; // riscv sp must be 16-byte aligned
+
+  // Point argv[] at the strings' places on the stack, then
+  // copy the whole image out at once.
+  s = args + ARGHDR;
+  for(i = 0; i < argc; i++){
+    uargv[i] = sp + (s - (char*)uargv);
+    s += strlen(s) + 1;
   }
-  ustack[argc] = 0;
-
-  // push the array of argv[] pointers.
-  sp -= (argc+1) * sizeof(uint64);
-  sp -= sp % 16;
-  if(sp < stackbase)
-    goto bad;
-  if(copyout(pagetable, sp, (char *)ustack, (argc+1)*sizeof(uint64)) < 0)
+  uargv[argc] = 0;
+  if(copyout(pagetable, sp, (char *)uargv, nbytes) < 0)
     goto bad;
 
   // arguments to user main(argc, argv)
@@ -126,6 +144,12 @@ exec(char *path, char **argv)
   safestrcpy(p->name, last, sizeof(p->name));
     
   // Commit to the user image.
+  vmunmapall(p);
+  begin_op();
+  vmaput(p->vma);
+  end_op();
+  memmove(p->vma, vma, sizeof(vma));
+  nvma = 0;
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
   p->sz = sz;
@@ -140,7 +164,8 @@ exec(char *path, char **argv)
   if (copy_pagetable_to_kernel(proc_kernel_pagetable, p, 0, p->sz) < 0)
     goto bad;
   p->kernel_pagetable = proc_kernel_pagetable;
-  switch_kernel_pagetable(p->kernel_pagetable);
+  if(p == myproc())
+    switch_kernel_pagetable(p->kernel_pagetable);
   proc_free_kernel_pagetable(old_proc_kernel_pagetable);
 
   if (p->pid == 1) {
@@ -152,8 +177,13 @@ exec(char *path, char **argv)
   if(pagetable)
     proc_freepagetable(pagetable, sz);
   if(ip){
+    vmaput(vma);
     iunlockput(ip);
     end_op();
+  } else if(nvma > 0){
+    begin_op();
+    vmaput(vma);
+    end_op();
   }
   if (proc_kernel_pagetable) {
     proc_free_kernel_pagetable(proc_kernel_pagetable);
@@ -161,27 +191,8 @@ exec(char *path, char **argv)
   return -1;
 }
 
-// Load a program segment into pagetable at virtual address va.
-// va must be page-aligned
-// and the pages from va to va+sz must already be mapped.
-// Returns 0 on success, -1 on failure.
-static int
-loadseg(pagetable_t pagetable, uint64 va, struct inode *ip, uint offset, uint sz)
+int
+exec(char *path, char *args, int argc, int len)
 {
-  uint i, n;
-  uint64 pa;
-
-  for(i = 0; i < sz; i += PGSIZE){
-    pa = walkaddr(pagetable, va + i);
-    if(pa == 0)
-      panic("loadseg: address should exist");
-    if(sz - i < PGSIZE)
-      n = sz - i;
-    else
-      n = PGSIZE;
-    if(readi(ip, 0, (uint64)pa, offset+i, n) != n)
-      return -1;
-  }
-  
-  return 0;
+  return execproc(myproc(), path, args, argc, len);
 }
@@ -18,6 +18,7 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct cpage *pages; // cached data pages (pcache.c)
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -38,3 +39,7 @@ struct devsw {
 extern struct devsw devsw[];
 
 #define CONSOLE 1
+#define STATS   2
+#define PROF    3
+#define TRACEDEV 4
+#define KLOG    5
@@ -44,6 +44,7 @@ fsinit(int dev) {
   if(sb.magic != FSMAGIC)
     panic("invalid file system");
   initlog(dev, &sb);
+  swapinit(dev, sb.swapstart, sb.nswap);
 }
 
 // Zero a block.
@@ -250,15 +251,17 @@ iget(uint dev, uint inum)
 
   acquire(&itable.lock);
 
-  // Is the inode already in the table?
+  // Is the inode already in the table? An unused entry that
+  // is still valid is reused as is, keeping its cached pages.
   empty = 0;
   for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
+    if((ip->ref > 0 || ip->valid) && ip->dev == dev && ip->inum == inum){
       ip->ref++;
       release(&itable.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
+    // Remember empty slot, preferring one with nothing cached.
+    if(ip->ref == 0 && (empty == 0 || (empty->valid && !ip->valid)))
       empty = ip;
   }
 
@@ -267,6 +270,7 @@ iget(uint dev, uint inum)
     panic("iget: no inodes");
 
   ip = empty;
+  pcacheinval(ip);
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
@@ -379,7 +383,7 @@ iunlockput(struct inode *ip)
 // Return the disk block address of the nth block in inode ip.
 // If there is no such block, bmap allocates one.
 // returns 0 if out of disk space.
-static uint
+uint
 bmap(struct inode *ip, uint bn)
 {
   uint addr, *a;
@@ -429,6 +433,8 @@ itrunc(struct inode *ip)
   struct buf *bp;
   uint *a;
 
+  pcacheinval(ip);
+
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
       bfree(ip->dev, ip->addrs[i]);
@@ -472,7 +478,7 @@ int
 readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 {
   uint tot, m;
-  struct buf *bp;
+  char *pa;
 
   if(off > ip->size || off + n < off)
     return 0;
@@ -480,17 +486,15 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
     n = ip->size - off;
 
   for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
-    uint addr = bmap(ip, off/BSIZE);
-    if(addr == 0)
+    if((pa = pcacheget(ip, PGROUNDDOWN(off))) == 0)
       break;
-    bp = bread(ip->dev, addr);
-    m = min(n - tot, BSIZE - off%BSIZE);
-    if(either_copyout(user_dst, dst, bp->data + (off % BSIZE), m) == -1) {
-      brelse(bp);
+    m = min(n - tot, PGSIZE - off%PGSIZE);
+    if(either_copyout(user_dst, dst, pa + (off % PGSIZE), m) == -1) {
+      kfree(pa);
       tot = -1;
       break;
     }
-    brelse(bp);
+    kfree(pa);
   }
   return tot;
 }
@@ -524,7 +528,8 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
       break;
     }
     log_write(bp);
-    brelse(bp);
+    pcacheupdate(ip, off, (char*)bp->data + (off % BSIZE), m);
+    bdrop(bp);
   }
 
   if(off > ip->size)
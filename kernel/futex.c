@@ -0,0 +1,130 @@
+//
+// Futexes: sleeping and waking keyed on a word of user memory.
+//
+// futex_wait(addr, val) sleeps if the word at addr still holds
+// val; futex_wake(addr, n) wakes up to n processes sleeping on
+// it. Waiters are found by the physical address of the word,
+// so a word in a MAP_SHARED page works across processes, as
+// well as between threads.
+//
+// Waiters hang off a hash table of buckets. A bucket's lock is
+// held from checking the word to sleeping, and by a waker, so
+// a wakeup after the word changes cannot be missed.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+struct fwaiter {
+  uint64 pa;               // the word waited on
+  int woken;
+  struct fwaiter *next;
+};
+
+struct {
+  struct spinlock lock;
+  struct fwaiter *waiters;
+} futexes[NFUTEX];
+
+void
+futexinit(void)
+{
+  int i;
+
+  for(i = 0; i < NFUTEX; i++)
+    initlock(&futexes[i].lock, "futex");
+}
+
+static int
+hash(uint64 pa)
+{
+  return (pa / sizeof(int)) % NFUTEX;
+}
+
+// Return the physical address of the word at user address va
+// of p, faulting in a private, writable page for it, or 0.
+// Being writable, the page cannot later be replaced by a copy.
+static uint64
+futexaddr(struct proc *p, uint64 va)
+{
+  pte_t *pte;
+
+  if(va % sizeof(int) != 0 || va >= MAXVA)
+    return 0;
+  pte = walk(p->pagetable, va, 0);
+  if((pte == 0 || (*pte & (PTE_V|PTE_W)) != (PTE_V|PTE_W)) && vmfault(p, va, 1) == 0)
+    pte = walk(p->pagetable, va, 0);
+  if(pte == 0 || (*pte & (PTE_V|PTE_U|PTE_W)) != (PTE_V|PTE_U|PTE_W))
+    return 0;
+  return walkaddr(p->pagetable, va) + va % PGSIZE;
+}
+
+// Sleep until woken by futexwake(), if the word at va holds
+// val. Returns 0 once woken, -1 if the word held something
+// else, va is not a writable word, or the process was killed.
+int
+futexwait(uint64 va, int val)
+{
+  struct proc *p = myproc();
+  struct fwaiter w, **wp;
+  uint64 pa;
+  int h;
+
+  if((pa = futexaddr(p, va)) == 0)
+    return -1;
+  h = hash(pa);
+  acquire(&futexes[h].lock);
+  if(*(volatile int*)pa != val){
+    release(&futexes[h].lock);
+    return -1;
+  }
+  w.pa = pa;
+  w.woken = 0;
+  w.next = futexes[h].waiters;
+  futexes[h].waiters = &w;
+  while(!w.woken && !killed(p))
+    sleep(&w, &futexes[h].lock);
+  if(!w.woken){
+    for(wp = &futexes[h].waiters; *wp != &w; wp = &(*wp)->next)
+      ;
+    *wp = w.next;
+  }
+  release(&futexes[h].lock);
+  return w.woken ? 0 : -1;
+}
+
+// Wake up to n of the processes waiting on the word at va,
+// oldest first. Returns how many were woken, or -1.
+int
+futexwake(uint64 va, int n)
+{
+  struct fwaiter **wp, *w, **oldest;
+  uint64 pa;
+  int h, woken;
+
+  if((pa = futexaddr(myproc(), va)) == 0)
+    return -1;
+  h = hash(pa);
+  acquire(&futexes[h].lock);
+  // new waiters go at the head of the list, so the oldest
+  // matching one is the last.
+  for(woken = 0; woken < n; woken++){
+    oldest = 0;
+    for(wp = &futexes[h].waiters; *wp; wp = &(*wp)->next)
+      if((*wp)->pa == pa)
+        oldest = wp;
+    if(oldest == 0)
+      break;
+    w = *oldest;
+    *oldest = w->next;
+    w->woken = 1;
+    wakeup(w);
+  }
+  release(&futexes[h].lock);
+  return woken;
+}
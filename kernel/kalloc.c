@@ -1,6 +1,18 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and slabs of small kernel objects (slab.c).
+//
+// A binary buddy allocator: free memory is kept as blocks of
+// 2^order pages, each aligned to its own size, on one free list
+// per order. kalloc_order() splits a larger block when no block
+// of the wanted order is free; kfree_order() merges a freed block
+// with its buddy (the other half of the next larger block) for as
+// long as that buddy is free too. kalloc()/kfree() are the
+// single-page fast path.
+//
+// Each allocated block has a reference count, kept for its
+// first page. Allocation sets it to 1, kdup() adds a reference,
+// and kfree() frees the block only when the last one is dropped.
 
 #include "types.h"
 #include "param.h"
@@ -8,25 +20,65 @@
 #include "spinlock.h"
 #include "riscv.h"
 #include "defs.h"
+#include "trace.h"
 
 void freerange(void *pa_start, void *pa_end);
 
 extern char end[]; // first address after kernel.
                    // defined by kernel.ld.
 
+#define MAXORDER 10   // largest block is 2^MAXORDER pages (4 MB)
+#define NPAGES ((PHYSTOP - KERNBASE) / PGSIZE)
+#define NOTFREE 0xff  // kmem.order[] of a page that starts no free block
+
+#define PA2IDX(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+#define IDX2PA(i) ((struct run*)(KERNBASE + (uint64)(i) * PGSIZE))
+
 struct run {
   struct run *next;
+  struct run *prev;
 };
 
 struct {
   struct spinlock lock;
-  struct run *freelist;
+  struct run free[MAXORDER+1]; // list heads, one per order
+  int nfree[MAXORDER+1];       // number of blocks on each list
+  // for each page, the order of the free block that starts
+  // there, or NOTFREE.
+  uchar order[NPAGES];
+  // for each allocated block, its reference count (atomic).
+  int ref[NPAGES];
 } kmem;
 
+static void
+push(int order, struct run *r)
+{
+  r->next = kmem.free[order].next;
+  r->prev = &kmem.free[order];
+  r->next->prev = r;
+  kmem.free[order].next = r;
+  kmem.nfree[order]++;
+  kmem.order[PA2IDX(r)] = order;
+}
+
+static void
+unlink(int order, struct run *r)
+{
+  r->prev->next = r->next;
+  r->next->prev = r->prev;
+  kmem.nfree[order]--;
+  kmem.order[PA2IDX(r)] = NOTFREE;
+}
+
 void
 kinit()
 {
+  int i;
+
   initlock(&kmem.lock, "kmem");
+  for(i = 0; i <= MAXORDER; i++)
+    kmem.free[i].next = kmem.free[i].prev = &kmem.free[i];
+  memset(kmem.order, NOTFREE, sizeof(kmem.order));
   freerange(end, (void*)PHYSTOP);
 }
 
@@ -35,33 +87,116 @@ freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE){
+    kmem.ref[PA2IDX(p)] = 1;
     kfree(p);
+  }
 }
 
-// Free the page of physical memory pointed at by pa,
-// which normally should have been returned by a
-// call to kalloc().  (The exception is when
-// initializing the allocator; see kinit above.)
+// Drop a reference to the block of 2^order pages pointed at
+// by pa, which normally should have been returned by a call
+// to kalloc_order(order), and free it if that was the last.
+// (The exception is when initializing the allocator; see
+// kinit above.)
 void
-kfree(void *pa)
+kfree_order(void *pa, int order)
 {
-  struct run *r;
+  uint64 i, buddy;
 
-  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+  if(order < 0 || order > MAXORDER || ((uint64)pa % (PGSIZE << order)) != 0 ||
+     (char*)pa < end || (uint64)pa + (PGSIZE << order) > PHYSTOP)
     panic("kfree");
 
-  // Fill with junk to catch dangling refs.
-  memset(pa, 1, PGSIZE);
+  // check and drop the reference under the lock, so that two
+  // racing frees of the last reference cannot both see it.
+  i = PA2IDX(pa);
+  acquire(&kmem.lock);
+  if(kmem.order[i] != NOTFREE || kmem.ref[i] <= 0)
+    panic("kfree: already free");
+  if(__sync_sub_and_fetch(&kmem.ref[i], 1) > 0){
+    release(&kmem.lock);
+    return;
+  }
+  release(&kmem.lock);
 
-  r = (struct run*)pa;
+  // Fill with junk to catch dangling refs.
+  memset(pa, 1, PGSIZE << order);
 
   acquire(&kmem.lock);
-  r->next = kmem.freelist;
-  kmem.freelist = r;
+  for(; order < MAXORDER; order++){
+    buddy = i ^ (1L << order);
+    if(buddy >= NPAGES || kmem.order[buddy] != order)
+      break;
+    // the buddy is free as a whole: merge with it.
+    unlink(order, IDX2PA(buddy));
+    i &= ~(1L << order);
+  }
+  push(order, IDX2PA(i));
   release(&kmem.lock);
 }
 
+// Take a block of 2^order pages off the free lists, or return 0.
+// When memory runs out, a single page is made by taking pages
+// back from the page cache one at a time until the allocation
+// succeeds. A larger block is not: callers of those fall back
+// to smaller ones, and freeing scattered pages would seldom
+// make a free block of the size they want anyway.
+static void *
+allocblock(int order)
+{
+  struct run *r = 0;
+  uint64 i;
+  int k;
+
+  do {
+    acquire(&kmem.lock);
+    for(k = order; k <= MAXORDER; k++)
+      if(kmem.nfree[k] > 0)
+        break;
+    if(k <= MAXORDER){
+      r = kmem.free[k].next;
+      unlink(k, r);
+      // give back the upper halves until the block is
+      // the size that was asked for.
+      i = PA2IDX(r);
+      while(k > order){
+        k--;
+        push(k, IDX2PA(i + (1L << k)));
+      }
+      kmem.ref[i] = 1;
+    }
+    release(&kmem.lock);
+  } while(r == 0 && order == 0 && pcachereclaim());
+
+  if(r)
+    memset((char*)r, 5, PGSIZE << order); // fill with junk
+  return (void*)r;
+}
+
+// Allocate 2^order physically contiguous pages, aligned
+// to their size. Returns a pointer that the kernel can use.
+// Returns 0 if the memory cannot be allocated.
+void *
+kalloc_order(int order)
+{
+  void *r;
+
+  if(order < 0 || order > MAXORDER)
+    return 0;
+  if((r = allocblock(order)) == 0)
+    TRACE(TE_KALLOCFAIL, order, 0);
+  return r;
+}
+
+// Free the page of physical memory pointed at by pa,
+// which normally should have been returned by a
+// call to kalloc().
+void
+kfree(void *pa)
+{
+  kfree_order(pa, 0);
+}
+
 // Allocate one 4096-byte page of physical memory.
 // Returns a pointer that the kernel can use.
 // Returns 0 if the memory cannot be allocated.
@@ -71,12 +206,72 @@ kalloc(void)
   struct run *r;
 
   acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
+  r = kmem.free[0].next;
+  if(r == &kmem.free[0]){
+    // no single free page: split a larger block, or
+    // swap a page out to make one.
+    release(&kmem.lock);
+    while((r = allocblock(0)) == 0 && swapreclaim())
+      ;
+    if(r == 0)
+      TRACE(TE_KALLOCFAIL, 0, 0);
+    return (void*)r;
+  }
+  unlink(0, r);
+  kmem.ref[PA2IDX(r)] = 1;
   release(&kmem.lock);
 
-  if(r)
-    memset((char*)r, 5, PGSIZE); // fill with junk
+  memset((char*)r, 5, PGSIZE); // fill with junk
   return (void*)r;
 }
+
+// Add a reference to the allocated block pointed at by pa;
+// the block is freed only after one more kfree().
+void
+kdup(void *pa)
+{
+  uint64 i = PA2IDX(pa);
+
+  if((char*)pa < end || (uint64)pa >= PHYSTOP || kmem.ref[i] <= 0)
+    panic("kdup");
+  __sync_fetch_and_add(&kmem.ref[i], 1);
+}
+
+// Split the allocated block of 2^order pages at pa into
+// single pages, each with the block's reference count, so that
+// they can be kfree()d one at a time.
+void
+ksplit(void *pa, int order)
+{
+  uint64 i = PA2IDX(pa), j;
+
+  if((char*)pa < end || (uint64)pa >= PHYSTOP || kmem.ref[i] <= 0)
+    panic("ksplit");
+  for(j = 1; j < (1L << order); j++)
+    kmem.ref[i + j] = kmem.ref[i];
+}
+
+// Return the number of references to the allocated block
+// pointed at by pa.
+int
+kref(void *pa)
+{
+  return kmem.ref[PA2IDX(pa)];
+}
+
+// Format free-memory counters for the statistics device.
+int
+kallocstats(char *buf, int sz)
+{
+  int n, k, npages;
+
+  acquire(&kmem.lock);
+  npages = 0;
+  for(k = 0; k <= MAXORDER; k++)
+    npages += kmem.nfree[k] << k;
+  n = snprintf(buf, sz, "kalloc: free pages %d\n", npages);
+  for(k = 0; k <= MAXORDER; k++)
+    n += snprintf(buf+n, sz-n, "kalloc: order %d free blocks %d\n", k, kmem.nfree[k]);
+  release(&kmem.lock);
+  return n;
+}
@@ -0,0 +1,182 @@
+//
+// The kernel log. printf() appends its output to a ring of the
+// CPU it runs on, with interrupts off, so appending takes no
+// lock and never waits for the uart. klogdrain() sends what
+// the rings hold to the uart's transmit buffer, whole lines at
+// a time so that the lines of different CPUs do not mix; it is
+// called after a printf() made with interrupts on, and from the
+// uart and timer interrupts, until the rings are empty.
+//
+// Bytes already sent stay in a ring until written over, and
+// reading the klog device takes them out, one CPU's after
+// another. A ring full of unsent bytes drops new ones and
+// counts them.
+//
+// Once panic() starts, printf() writes straight to the uart,
+// after klogpanic() has sent what the rings still hold.
+//
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "defs.h"
+
+static struct {
+  char buf[NKLOG];
+  uint head;                 // next to read; advanced by readers
+  uint out;                  // next to send; advanced by klogdrain()
+  uint tail;                 // next to write; advanced by this CPU
+  uint nl;                   // just past the last newline written
+  uint dropped;
+} klogs[NCPU];
+
+// serializes klogdrain() and readers of the klog device,
+// so that out and head only move under it.
+static struct {
+  struct spinlock lock;
+  int cpu;                   // ring klogdrain() sends from first
+} klog;
+
+// Append c to this CPU's ring.
+// Caller has interrupts off.
+void
+klogputc(int c)
+{
+  int id = cpuid();
+
+  if(klogs[id].tail - klogs[id].out >= NKLOG){
+    klogs[id].dropped++;
+    return;
+  }
+  klogs[id].buf[klogs[id].tail % NKLOG] = c;
+  // klogdrain() must see the byte before the new tail.
+  __sync_synchronize();
+  klogs[id].tail++;
+  if(c == '\n')
+    klogs[id].nl = klogs[id].tail;
+}
+
+// Send the complete lines in the rings to the uart, as many as
+// its transmit buffer has room for.
+//
+// May be called with interrupts off, from a trap handler as
+// well as from a process, and must not sleep: it takes only
+// klog.lock and uart_tx_lock, which are never held with
+// interrupts on, and uartstart()'s wakeup(). The caller must
+// hold no spinlock, since a caller holding one of those, or a
+// process's lock, would deadlock.
+void
+klogdrain(void)
+{
+  uint tail, end, n, m;
+  int i, c;
+
+  acquire(&klog.lock);
+  for(i = 0; i < NCPU; i++){
+    c = klog.cpu;
+    tail = klogs[c].tail;
+    end = klogs[c].nl;
+    __sync_synchronize();
+    if((int)(end - klogs[c].out) < 0)
+      end = klogs[c].out;   // the rest of a long line went already
+    if(end == klogs[c].out && tail - end >= NKLOG/2)
+      end = tail;   // a very long line; don't let it fill the ring
+    while(klogs[c].out != end){
+      n = end - klogs[c].out;
+      if(n > NKLOG - klogs[c].out % NKLOG)
+        n = NKLOG - klogs[c].out % NKLOG;
+      m = uarttrywrite(&klogs[c].buf[klogs[c].out % NKLOG], n);
+      klogs[c].out += m;
+      if(m < n){
+        // the uart is busy. the rest of the line goes first
+        // when its interrupt calls again.
+        release(&klog.lock);
+        return;
+      }
+    }
+    klog.cpu = (c + 1) % NCPU;
+  }
+  release(&klog.lock);
+}
+
+// Write what the rings have not sent straight to the uart, for
+// panic(). Takes no locks, since the panicking CPU may hold
+// klog.lock; other CPUs may still be appending.
+void
+klogpanic(void)
+{
+  int c;
+
+  for(c = 0; c < NCPU; c++)
+    for(; klogs[c].out != klogs[c].tail; klogs[c].out++)
+      uartputc_sync(klogs[c].buf[klogs[c].out % NKLOG]);
+}
+
+static int
+klogwrite(int user_src, uint64 src, int n)
+{
+  return -1;
+}
+
+// Take the bytes out of the rings, up to n, one CPU's after
+// another. Returns 0 when there are none left.
+static int
+klogread(int user_dst, uint64 dst, int n)
+{
+  char batch[128];
+  uint start, skip;
+  int c, m, tot;
+
+  tot = 0;
+  for(c = 0; c < NCPU; c++){
+    for(;;){
+      // copy out without the lock, since that may sleep.
+      acquire(&klog.lock);
+      if(klogs[c].tail - klogs[c].head > NKLOG)
+        klogs[c].head = klogs[c].tail - NKLOG;
+      start = klogs[c].head;
+      for(m = 0; m < sizeof(batch) && start + m != klogs[c].tail && tot + m < n; m++)
+        batch[m] = klogs[c].buf[(start + m) % NKLOG];
+      // the CPU may have written over the oldest bytes, which
+      // were already sent, while they were being copied.
+      __sync_synchronize();
+      skip = 0;
+      if(klogs[c].tail - start > NKLOG)
+        skip = klogs[c].tail - NKLOG - start;
+      if(skip > m)
+        skip = m;
+      klogs[c].head = start + m;
+      release(&klog.lock);
+      if(m == 0)
+        break;
+      if(either_copyout(user_dst, dst + tot, batch + skip, m - skip) < 0)
+        return -1;
+      tot += m - skip;
+    }
+  }
+  return tot;
+}
+
+// Format kernel log counters for the statistics device.
+int
+klogstats(char *buf, int sz)
+{
+  int c, dropped;
+
+  dropped = 0;
+  for(c = 0; c < NCPU; c++)
+    dropped += klogs[c].dropped;
+  return snprintf(buf, sz, "klog: dropped %d\n", dropped);
+}
+
+void
+kloginit(void)
+{
+  initlock(&klog.lock, "klog");
+  devsw[KLOG].read = klogread;
+  devsw[KLOG].write = klogwrite;
+}
@@ -6,6 +6,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 // Simple logging that allows concurrent FS system calls.
 //
@@ -129,12 +130,15 @@ begin_op(void)
   acquire(&log.lock);
   while(1){
     if(log.committing){
+      TRACE(TE_OPWAIT, log.outstanding, 1);
       sleep(&log, &log.lock);
     } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
       // this op might exhaust log space; wait for commit.
+      TRACE(TE_OPWAIT, log.outstanding, 0);
       sleep(&log, &log.lock);
     } else {
       log.outstanding += 1;
+      TRACE(TE_OPBEGIN, log.outstanding, 0);
       release(&log.lock);
       break;
     }
@@ -150,6 +154,7 @@ end_op(void)
 
   acquire(&log.lock);
   log.outstanding -= 1;
+  TRACE(TE_OPEND, log.outstanding, 0);
   if(log.committing)
     panic("log.committing");
   if(log.outstanding == 0){
@@ -194,11 +199,13 @@ static void
 commit()
 {
   if (log.lh.n > 0) {
+    TRACE(TE_COMMIT, log.lh.n, 0);
     write_log();     // Write modified blocks from cache to log
     write_head();    // Write header to disk -- the real commit
     install_trans(0); // Now install writes to home locations
     log.lh.n = 0;
     write_head();    // Erase the transaction from the log
+    TRACE(TE_COMMITDONE, 0, 0);
   }
 }
 
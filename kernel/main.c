@@ -27,6 +27,12 @@ main()
     binit();         // buffer cache
     iinit();         // inode table
     fileinit();      // file table
+    pipeinit();      // pipe cache
+    pcacheinit();    // file page cache
+    futexinit();     // futex wait queues
+    statsinit();     // statistics device
+    profinit();      // profiler device
+    traceinit();     // trace device
     virtio_disk_init(); // emulated hard disk
     userinit();      // first user process
     __sync_synchronize();
@@ -33,6 +33,8 @@
 #define CLINT 0x2000000L
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
+#define TIMEBASE 10000000   // CLINT_MTIME (and time CSR) cycles per second
+#define TICKCYCLES 1000000  // cycles between timer interrupts (clock ticks)
 
 // qemu puts platform-level interrupt controller (PLIC) here.
 #define PLIC 0x0c000000L
@@ -66,14 +68,27 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   mmap() regions, allocated downward from MMAPTOP
+//   ...
 //   USYSCALL (shared with kernel)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+// the per-process kernel page table mirrors user memory only
+// below PLIC, so mmap() regions must end below it.
+#define MMAPTOP (PLIC - PGSIZE)
 #ifdef LAB_PGTBL
 #define USYSCALL (TRAPFRAME - PGSIZE)
 
+// Read-only to the process; the kernel refreshes it every time
+// the process returns to user space, which a timer interrupt
+// makes it do at least once per tick while it runs.
 struct usyscall {
-  int pid;  // Process ID
+  int pid;          // Process ID
+  int cpu;          // CPU the process is running on
+  uint ticks;       // clock ticks since boot, as uptime() returns
+  uint64 timebase;  // cycles per second, for runtime
+  uint64 tickcycles; // cycles per clock tick
+  uint64 runtime;   // cycles the process has spent running
 };
 #endif
@@ -1,13 +1,24 @@
+#ifndef NPROC
 #define NPROC        64  // maximum number of processes
+#endif
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
+#define NVMA         16  // demand-paged regions per process
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
+#define MAXARGORDER   5  // exec argument strings fit in 2^5 pages
+#define ARGHDR       ((MAXARG+1)*8)  // room for argv[] before the strings
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
 #define FSSIZE       2000  // size of file system in blocks
+#define NSWAP       32768  // size of swap area in blocks, after the file system
+#define WSINTERVAL   10  // clock ticks between working-set samples
+#define NPROFSAMPLE 2048  // profiling samples kept per CPU
+#define PROFMAXRATE   100  // most profiling samples per clock tick
+#define NTRACEEVENT 1024  // trace events kept per CPU
+#define NKLOG       4096  // bytes of kernel log kept per CPU
+#define NFUTEX       64  // futex wait queues (hash buckets)
 #define MAXPATH      128   // maximum file path name
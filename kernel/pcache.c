@@ -0,0 +1,279 @@
+//
+// Page cache: the contents of files and directories, a page
+// at a time, keyed by (inode, page-aligned offset).
+//
+// readi() is served from here; writei() writes through the
+// buffer cache and the log as before and then updates the
+// cached page. The buffer cache holds file data only while it
+// is being read or written (see bdrop()), so it is left to
+// metadata and the log.
+//
+// Each in-memory inode keeps a list of its cached pages, and
+// all cached pages are on one LRU list. There is no fixed
+// size: the cache grows for as long as kalloc() has pages to
+// give, and kalloc() calls pcachereclaim() to take back the
+// least recently used ones when it runs out.
+//
+// Each cached page holds one reference to its memory (see
+// kdup()). Page faults map cached pages straight into user
+// address spaces with another reference; a write to a page
+// mapped that way drops it from the cache instead, so that
+// mappings keep the old contents.
+//
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "file.h"
+#include "defs.h"
+
+struct cpage {
+  struct inode *ip;     // owner; 0 if on the free list
+  uint off;             // file offset of the page
+  char *pa;
+  struct cpage *next;   // ip->pages, or the free list
+  struct cpage *lprev;  // LRU list
+  struct cpage *lnext;
+};
+
+struct {
+  struct spinlock lock;
+  // lru.lnext is most recently used, lru.lprev least.
+  struct cpage lru;
+  // pcachereclaim() runs inside kalloc(), possibly called by
+  // the slab allocator with a cache lock held, so descriptors
+  // come from a free list of their own.
+  struct cpage *free;
+  int npages;
+  int hits;
+  int misses;
+  int reclaimed;
+} pcache;
+
+void
+pcacheinit(void)
+{
+  initlock(&pcache.lock, "pcache");
+  pcache.lru.lprev = &pcache.lru;
+  pcache.lru.lnext = &pcache.lru;
+}
+
+// Put c at the most recently used end of the LRU list.
+// Caller holds pcache.lock.
+static void
+lru_push(struct cpage *c)
+{
+  c->lnext = pcache.lru.lnext;
+  c->lprev = &pcache.lru;
+  pcache.lru.lnext->lprev = c;
+  pcache.lru.lnext = c;
+}
+
+// Caller holds pcache.lock.
+static void
+lru_remove(struct cpage *c)
+{
+  c->lprev->lnext = c->lnext;
+  c->lnext->lprev = c->lprev;
+}
+
+// Find ip's page at off.
+// Caller holds pcache.lock.
+static struct cpage*
+lookup(struct inode *ip, uint off)
+{
+  struct cpage *c;
+
+  for(c = ip->pages; c; c = c->next)
+    if(c->off == off)
+      return c;
+  return 0;
+}
+
+// Take c off its inode's list and the LRU list, and give
+// up the cache's reference to its page.
+// Caller holds pcache.lock.
+static void
+drop(struct cpage *c)
+{
+  struct cpage **pp;
+
+  for(pp = &c->ip->pages; *pp != c; pp = &(*pp)->next)
+    ;
+  *pp = c->next;
+  lru_remove(c);
+  kfree(c->pa);
+  c->ip = 0;
+  c->next = pcache.free;
+  pcache.free = c;
+  pcache.npages--;
+}
+
+// Return a free descriptor, or 0 if out of memory.
+static struct cpage*
+cpagealloc(void)
+{
+  struct cpage *c, *cs;
+  int i;
+
+  acquire(&pcache.lock);
+  if((c = pcache.free) != 0){
+    pcache.free = c->next;
+    release(&pcache.lock);
+    return c;
+  }
+  release(&pcache.lock);
+
+  if((cs = kalloc()) == 0)
+    return 0;
+  acquire(&pcache.lock);
+  for(i = 1; i < PGSIZE / sizeof(*cs); i++){
+    cs[i].ip = 0;
+    cs[i].next = pcache.free;
+    pcache.free = &cs[i];
+  }
+  release(&pcache.lock);
+  return &cs[0];
+}
+
+// Fill pa with the page of ip at off, zeros past the end of
+// the file. Returns -1 if a block cannot be read.
+// Caller holds ip->lock.
+static int
+fill(struct inode *ip, char *pa, uint off)
+{
+  struct buf *bp;
+  uint b, addr;
+
+  memset(pa, 0, PGSIZE);
+  for(b = off; b < off + PGSIZE && b < ip->size; b += BSIZE){
+    if((addr = bmap(ip, b/BSIZE)) == 0)
+      return -1;
+    bp = bread(ip->dev, addr);
+    memmove(pa + (b - off), bp->data, ip->size - b < BSIZE ? ip->size - b : BSIZE);
+    bdrop(bp);
+  }
+  return 0;
+}
+
+// Return the page holding ip's data at page-aligned offset
+// off, reading it in if it is not cached, with a reference
+// for the caller, who must kfree() it when done. Returns 0 if
+// off is past the end of the file, or if out of memory or the
+// file cannot be read.
+// Caller holds ip->lock, which keeps two readers of one file
+// from loading the same page twice.
+void*
+pcacheget(struct inode *ip, uint off)
+{
+  struct cpage *c;
+  char *pa;
+
+  if(off >= ip->size)
+    return 0;
+
+  acquire(&pcache.lock);
+  if((c = lookup(ip, off)) != 0){
+    lru_remove(c);
+    lru_push(c);
+    kdup(c->pa);
+    pcache.hits++;
+    release(&pcache.lock);
+    return c->pa;
+  }
+  pcache.misses++;
+  release(&pcache.lock);
+
+  if((c = cpagealloc()) == 0)
+    return 0;
+  if((pa = kalloc()) == 0 || fill(ip, pa, off) < 0){
+    if(pa)
+      kfree(pa);
+    acquire(&pcache.lock);
+    c->next = pcache.free;
+    pcache.free = c;
+    release(&pcache.lock);
+    return 0;
+  }
+
+  acquire(&pcache.lock);
+  c->ip = ip;
+  c->off = off;
+  c->pa = pa;
+  c->next = ip->pages;
+  ip->pages = c;
+  lru_push(c);
+  pcache.npages++;
+  kdup(pa);
+  release(&pcache.lock);
+  return pa;
+}
+
+// writei() has just written the n bytes at src to ip at off,
+// all within one block: update the cached page, if any.
+// Caller holds ip->lock, so no new mapping of the page can
+// appear meanwhile.
+void
+pcacheupdate(struct inode *ip, uint off, char *src, uint n)
+{
+  struct cpage *c;
+
+  acquire(&pcache.lock);
+  if((c = lookup(ip, PGROUNDDOWN(off))) != 0){
+    if(kref(c->pa) > 1)
+      drop(c);    // mapped somewhere; leave it the old contents
+    else
+      memmove(c->pa + off % PGSIZE, src, n);
+  }
+  release(&pcache.lock);
+}
+
+// Drop all cached pages of ip, which is being truncated or
+// whose inode table entry is being reused. Processes that map
+// them keep the old contents.
+void
+pcacheinval(struct inode *ip)
+{
+  acquire(&pcache.lock);
+  while(ip->pages)
+    drop(ip->pages);
+  release(&pcache.lock);
+}
+
+// Drop the least recently used page that no one maps, to
+// give kalloc() memory. Returns 1 if a page was freed, 0 if
+// the cache has none to give.
+int
+pcachereclaim(void)
+{
+  struct cpage *c;
+
+  acquire(&pcache.lock);
+  for(c = pcache.lru.lprev; c && c != &pcache.lru; c = c->lprev){
+    if(kref(c->pa) == 1){
+      drop(c);
+      pcache.reclaimed++;
+      release(&pcache.lock);
+      return 1;
+    }
+  }
+  release(&pcache.lock);
+  return 0;
+}
+
+// Format page cache counters for the statistics device.
+int
+pcachestats(char *buf, int sz)
+{
+  int n;
+
+  acquire(&pcache.lock);
+  n = snprintf(buf, sz, "pcache: cached pages %d hits %d misses %d reclaimed %d\n",
+               pcache.npages, pcache.hits, pcache.misses, pcache.reclaimed);
+  release(&pcache.lock);
+  return n;
+}
@@ -0,0 +1,13 @@
+// A process's hardware performance counts, as perfinfo()
+// reports them. cycle and instret count only while the process
+// runs; IPC is instret / cycles.
+struct perfinfo {
+  uint64 cycles;      // cycles running
+  uint64 instret;     // instructions retired running
+  uint64 ucycles;     // of those, in user space
+  uint64 uinstret;
+  uint64 ccycles;     // the same, summed over the children
+  uint64 cinstret;    // that wait() has reaped, and theirs
+  uint64 cucycles;
+  uint64 cuinstret;
+};
@@ -17,14 +17,22 @@
 
 volatile int panicked = 0;
 
-// lock to avoid interleaving concurrent printf's.
-static struct {
-  struct spinlock lock;
-  int locking;
-} pr;
+// whether printf() appends to the kernel log (see klog.c);
+// until printfinit(), and once panic() starts, it writes
+// straight to the uart instead.
+static int logging;
 
 static char digits[] = "0123456789abcdef";
 
+static void
+putc(int c)
+{
+  if(logging)
+    klogputc(c);
+  else
+    consputc(c);
+}
+
 static void
 printint(int xx, int base, int sign)
 {
@@ -46,17 +54,17 @@ printint(int xx, int base, int sign)
     buf[i++] = '-';
 
   while(--i >= 0)
-    consputc(buf[i]);
+    putc(buf[i]);
 }
 
 static void
 printptr(uint64 x)
 {
   int i;
-  consputc('0');
-  consputc('x');
+  putc('0');
+  putc('x');
   for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)
-    consputc(digits[x >> (sizeof(uint64) * 8 - 4)]);
+    putc(digits[x >> (sizeof(uint64) * 8 - 4)]);
 }
 
 // Print to the console. only understands %d, %x, %p, %s.
@@ -64,12 +72,17 @@ void
 printf(char *fmt, ...)
 {
   va_list ap;
-  int i, c, locking;
+  int i, c, drain;
   char *s;
 
-  locking = pr.locking;
-  if(locking)
-    acquire(&pr.lock);
+  // send the log on to the uart at the end only if the caller
+  // had interrupts on, so holds no spinlock and is not in a
+  // trap handler; otherwise the next uart or timer interrupt
+  // sends it.
+  drain = logging && intr_get();
+
+  // keep this printf's output together in one CPU's log.
+  push_off();
 
   if (fmt == 0)
     panic("null fmt");
@@ -77,7 +90,7 @@ printf(char *fmt, ...)
   va_start(ap, fmt);
   for(i = 0; (c = fmt[i] & 0xff) != 0; i++){
     if(c != '%'){
-      consputc(c);
+      putc(c);
       continue;
     }
     c = fmt[++i] & 0xff;
@@ -97,28 +110,32 @@ printf(char *fmt, ...)
       if((s = va_arg(ap, char*)) == 0)
         s = "(null)";
       for(; *s; s++)
-        consputc(*s);
+        putc(*s);
       break;
     case '%':
-      consputc('%');
+      putc('%');
       break;
     default:
       // Print unknown % sequence to draw attention.
-      consputc('%');
-      consputc(c);
+      putc('%');
+      putc(c);
       break;
     }
   }
   va_end(ap);
 
-  if(locking)
-    release(&pr.lock);
+  pop_off();
+  if(drain)
+    klogdrain();
 }
 
 void
 panic(char *s)
 {
-  pr.locking = 0;
+  if(logging){
+    logging = 0;
+    klogpanic();
+  }
   printf("panic: ");
   printf(s);
   printf("\n");
@@ -130,6 +147,6 @@ panic(char *s)
 void
 printfinit(void)
 {
-  initlock(&pr.lock, "pr");
-  pr.locking = 1;
+  kloginit();
+  logging = 1;
 }
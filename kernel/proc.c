@@ -4,6 +4,9 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "procinfo.h"
+#include "trace.h"
+#include "perfinfo.h"
 #include "defs.h"
 
 struct cpu cpus[NCPU];
@@ -13,10 +16,24 @@ struct proc proc[NPROC];
 struct proc *initproc;
 
 int nextpid = 1;
-struct spinlock pid_lock;
+
+// UNUSED procs, so allocproc() need not search proc[].
+struct {
+  struct spinlock lock;
+  struct proc *head;
+} freeprocs;
+
+// The other procs, by pid, for findproc().
+struct {
+  struct spinlock lock;
+  struct proc *chain[NPROC];
+} pidhash;
 
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static void detach(struct proc *p);
+static void setparent(struct proc *np, struct proc *p);
+static void wakeproc(struct proc *p, void *chan);
 
 extern char trampoline[]; // trampoline.S
 
@@ -46,31 +63,23 @@ proc_mapstacks(pagetable_t kpgtbl)
 }
 
 
-void
-proc_setstacks(pagetable_t kpgtbl, pagetable_t kpgtbl2)
-{
-  struct proc *p;
-  for(p = proc; p < &proc[NPROC]; p++) {
-    uint64 va = KSTACK((int) (p - proc));
-    pte_t* pte_addr = walk(kpgtbl, va, 0);
-    if(pte_addr == 0)
-      panic("proc_setstacks");
-    kvmmap(kpgtbl2, va, (uint64)PTE2PA(*pte_addr), PGSIZE, PTE_R | PTE_W);
-  }
-}
-
 // initialize the proc table.
 void
 procinit(void)
 {
   struct proc *p;
   
-  initlock(&pid_lock, "nextpid");
+  initlock(&freeprocs.lock, "freeprocs");
+  initlock(&pidhash.lock, "pidhash");
   initlock(&wait_lock, "wait_lock");
-  for(p = proc; p < &proc[NPROC]; p++) {
+  // backwards, so that the first allocated is proc[0].
+  for(p = &proc[NPROC-1]; p >= proc; p--) {
       initlock(&p->lock, "proc");
+      initlock(&p->vmlk, "vm");
       p->state = UNUSED;
       p->kstack = KSTACK((int) (p - proc));
+      p->next = freeprocs.head;
+      freeprocs.head = p;
   }
 }
 
@@ -108,18 +117,36 @@ myproc(void)
 int
 allocpid()
 {
-  int pid;
-  
-  acquire(&pid_lock);
-  pid = nextpid;
-  nextpid = nextpid + 1;
-  release(&pid_lock);
+  return __sync_fetch_and_add(&nextpid, 1);
+}
 
-  return pid;
+// Return the process with the given pid, with p->lock held,
+// or 0 if there is none.
+struct proc*
+findproc(int pid)
+{
+  struct proc *p;
+
+  if(pid <= 0)
+    return 0;
+  acquire(&pidhash.lock);
+  for(p = pidhash.chain[pid % NPROC]; p; p = p->next)
+    if(p->pid == pid)
+      break;
+  release(&pidhash.lock);
+  if(p == 0)
+    return 0;
+  // p may have been freed, and perhaps reused, meanwhile.
+  acquire(&p->lock);
+  if(p->pid != pid || p->state == UNUSED){
+    release(&p->lock);
+    return 0;
+  }
+  return p;
 }
 
-// Look in the process table for an UNUSED proc.
-// If found, initialize state required to run in the kernel,
+// Take an UNUSED proc off the free list.
+// If there is one, initialize state required to run in the kernel,
 // and return with p->lock held.
 // If there are no free procs, or a memory allocation fails, return 0.
 static struct proc*
@@ -127,19 +154,25 @@ allocproc(void)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state == UNUSED) {
-      goto found;
-    } else {
-      release(&p->lock);
-    }
-  }
-  return 0;
+  acquire(&freeprocs.lock);
+  if((p = freeprocs.head) != 0)
+    freeprocs.head = p->next;
+  release(&freeprocs.lock);
+  if(p == 0)
+    return 0;
 
-found:
+  // freeproc() may not yet have released p->lock.
+  acquire(&p->lock);
+  if(p->state != UNUSED)
+    panic("allocproc");
   p->pid = allocpid();
   p->state = USED;
+  acquire(&pidhash.lock);
+  p->next = pidhash.chain[p->pid % NPROC];
+  pidhash.chain[p->pid % NPROC] = p;
+  release(&pidhash.lock);
+  p->mm = p;
+  p->nthread = 1;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -148,6 +181,19 @@ found:
     return 0;
   }
 
+#ifdef LAB_PGTBL
+  // Allocate the page that user space reads at USYSCALL.
+  if((p->usyscall = (struct usyscall *)kalloc()) == 0){
+    freeproc(p);
+    release(&p->lock);
+    return 0;
+  }
+  memset(p->usyscall, 0, PGSIZE);
+  p->usyscall->pid = p->pid;
+  p->usyscall->timebase = TIMEBASE;
+  p->usyscall->tickcycles = TICKCYCLES;
+#endif
+
   // Allocate a kernel page table 
   p->kernel_pagetable = user_kvmmake();
   // proc_mapstacks(p->kernel_pagetable);
@@ -174,22 +220,63 @@ found:
 static void
 freeproc(struct proc *p)
 {
+  struct proc **pp;
+
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
+#ifdef LAB_PGTBL
+  if(p->usyscall)
+    kfree((void*)p->usyscall);
+  p->usyscall = 0;
+#endif
   if(p->pagetable)
     proc_freepagetable(p->pagetable, p->sz);
   if (p->kernel_pagetable)
     proc_free_kernel_pagetable(p->kernel_pagetable);
   p->pagetable = 0;
+  p->kernel_pagetable = 0;
   p->sz = 0;
-  p->pid = 0;
+  p->mm = 0;
+  p->nthread = 0;
   p->parent = 0;
+  p->children = 0;
+  p->sibling = 0;
   p->name[0] = 0;
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
+  p->runtime = 0;
+  p->utime = 0;
+  p->nvcsw = 0;
+  p->nivcsw = 0;
+  p->nfault = 0;
+  p->nsyscall = 0;
+  p->sctrace = 0;
+  p->profgen = 0;
+  memset(&p->hpm, 0, sizeof(p->hpm));
+  memset(&p->uhpm, 0, sizeof(p->uhpm));
+  memset(&p->chpm, 0, sizeof(p->chpm));
+  memset(&p->cuhpm, 0, sizeof(p->cuhpm));
+  p->swapok = 0;
+  p->swaphand = 0;
+  p->wstick = 0;
+  p->wsresident = 0;
+  p->wstouched = 0;
+  p->wsswapped = 0;
+
+  acquire(&pidhash.lock);
+  for(pp = &pidhash.chain[p->pid % NPROC]; *pp != p; pp = &(*pp)->next)
+    ;
+  *pp = p->next;
+  release(&pidhash.lock);
+  p->pid = 0;
   p->state = UNUSED;
+
+  acquire(&freeprocs.lock);
+  p->next = freeprocs.head;
+  freeprocs.head = p;
+  release(&freeprocs.lock);
 }
 
 // Create a user page table for a given process, with no user memory,
@@ -223,6 +310,18 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
+#ifdef LAB_PGTBL
+  // map the usyscall page just below the trapframe page,
+  // read-only for the process.
+  if(mappages(pagetable, USYSCALL, PGSIZE,
+              (uint64)(p->usyscall), PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+#endif
+
   return pagetable;
 }
 
@@ -233,10 +332,15 @@ proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
   uvmunmap(pagetable, TRAPFRAME, 1, 0);
+#ifdef LAB_PGTBL
+  uvmunmap(pagetable, USYSCALL, 1, 0);
+#endif
   uvmfree(pagetable, sz);
 }
 
 void proc_free_kernel_pagetable(pagetable_t pagetable) {
+  // the top 1 GB is the global kernel page table's.
+  pagetable[PX(2, TRAMPOLINE)] = 0;
   freewalk_pages(pagetable);
 }
 
@@ -282,39 +386,122 @@ userinit(void)
 }
 
 // Grow or shrink user memory by n bytes.
-// Return 0 on success, -1 on failure.
-int
+// Return the old size, read under vmlock() so that threads
+// growing the memory at once each get their own piece, or -1
+// on failure.
+uint64
 growproc(int n)
 {
   uint64 sz, old_sz;
   struct proc *p = myproc();
+  struct proc *mm = p->mm;
 
-  sz = p->sz;
-  old_sz = p->sz;
+  vmlock(p);
+  sz = mm->sz;
+  old_sz = mm->sz;
 
   if(n > 0){
-    if (sz + n < sz || sz + n >= PLIC) {
-      return -1;
+    if (sz + n < sz || sz + n >= PLIC || vmaoverlap(mm, sz, sz + n)) {
+      goto bad;
     }
-    if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
-      return -1;
+    // the kernel holds no pointers into p's memory here, so
+    // other pages of p may be swapped out to make room.
+    p->swapok = 1;
+    sz = uvmalloc(mm->pagetable, sz, sz + n, PTE_W);
+    p->swapok = 0;
+    if(sz == 0) {
+      goto bad;
     }
-    if (copy_pagetable_to_kernel(p->kernel_pagetable, p, old_sz, sz) < 0) {
-      userkernel_unmap(p->kernel_pagetable, sz, old_sz);
-      uvmdealloc(p->pagetable, sz, old_sz);
-      return -1;
+    if (copy_pagetable_to_kernel(mm->kernel_pagetable, mm, old_sz, sz) < 0) {
+      userkernel_unmap(mm->kernel_pagetable, sz, old_sz);
+      uvmdealloc(mm->pagetable, sz, old_sz);
+      goto bad;
     }
   } else if(n < 0){
     if (sz + n > sz) {
+      goto bad;
+    }
+    // the new end may fall inside a megapage; break it into
+    // 4 KB pages first. the kernel copy goes first so that a
+    // failure leaves the two tables mapping the same memory.
+    if (uvmsplit(mm->kernel_pagetable, PGROUNDUP(sz + n), 0) < 0 ||
+        uvmsplit(mm->pagetable, PGROUNDUP(sz + n), 1) < 0) {
+      goto bad;
+    }
+    uvmunmapsync(mm->pagetable, mm->kernel_pagetable, PGROUNDUP(sz + n), PGROUNDUP(sz));
+    sz += n;
+  }
+  mm->sz = sz;
+  vmunlock(p);
+  return old_sz;
+
+ bad:
+  vmunlock(p);
+  return -1;
+}
+
+// Serialize changes to the memory that p shares with its
+// threads. Returns -1, without waiting, if the caller holds a
+// spinlock and another thread is changing the memory.
+int
+vmlock(struct proc *p)
+{
+  struct proc *mm = p->mm;
+  int sleepok = cansleep();
+
+  acquire(&mm->vmlk);
+  while(mm->vmbusy){
+    if(!sleepok){
+      release(&mm->vmlk);
       return -1;
     }
-    sz = uvmdealloc(p->pagetable, sz, sz + n);
-    userkernel_unmap(p->kernel_pagetable, sz, sz + n);
+    sleep(&mm->vmbusy, &mm->vmlk);
   }
-  p->sz = sz;
+  mm->vmbusy = 1;
+  release(&mm->vmlk);
   return 0;
 }
 
+void
+vmunlock(struct proc *p)
+{
+  struct proc *mm = p->mm;
+
+  acquire(&mm->vmlk);
+  mm->vmbusy = 0;
+  wakeup(&mm->vmbusy);
+  release(&mm->vmlk);
+}
+
+// The caller has just unmapped pages from the memory of p, the
+// current process: wait until no other thread of it can still
+// reach them through its CPU's TLB. A thread that was running
+// must have gone through the scheduler or back to user space
+// since, both of which flush the TLB; there are no
+// inter-processor interrupts to make it flush sooner.
+void
+tlbsync(struct proc *p)
+{
+  struct proc *q;
+  uint gen;
+
+  sfence_vma();
+  if(p->mm->nthread == 1)
+    return;
+  for(q = proc; q < &proc[NPROC]; q++){
+    if(q == p || q->mm != p->mm)
+      continue;
+    acquire(&q->lock);
+    gen = q->tlbgen;
+    while(q->mm == p->mm && q->state == RUNNING && q->tlbgen == gen){
+      release(&q->lock);
+      yield();
+      acquire(&q->lock);
+    }
+    release(&q->lock);
+  }
+}
+
 // Create a new process, copying the parent.
 // Sets up child kernel stack to return as if from fork() system call.
 int
@@ -323,26 +510,40 @@ fork(void)
   int i, pid;
   struct proc *np;
   struct proc *p = myproc();
+  struct proc *mm = p->mm;
 
   // Allocate process.
   if((np = allocproc()) == 0){
     return -1;
   }
 
-  // Copy user memory from parent to child.
-  if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
+  // Copy user memory from parent to child, which other threads
+  // of the parent must not change meanwhile.
+  vmlock(p);
+  if(uvmcopy(mm->pagetable, np->pagetable, mm->sz) < 0){
+    vmunlock(p);
     freeproc(np);
     release(&np->lock);
     return -1;
   }
-  np->sz = p->sz;
+  np->sz = mm->sz;
 
   // set kernel page table in child.
   if (copy_pagetable_to_kernel(np->kernel_pagetable, np, 0, np->sz) < 0) {
+    vmunlock(p);
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+
+  // share or copy demand-paged regions.
+  if(vmadup(mm, np) < 0){
+    vmunlock(p);
     freeproc(np);
     release(&np->lock);
     return -1;
   }
+  vmunlock(p);
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -357,13 +558,15 @@ fork(void)
   np->cwd = idup(p->cwd);
 
   safestrcpy(np->name, p->name, sizeof(p->name));
+  np->sctrace = p->sctrace;
+  np->profgen = p->profgen;
 
   pid = np->pid;
 
   release(&np->lock);
 
   acquire(&wait_lock);
-  np->parent = p;
+  setparent(np, p);
   release(&wait_lock);
 
   acquire(&np->lock);
@@ -373,6 +576,165 @@ fork(void)
   return pid;
 }
 
+// Create a new process running the program at path, as fork()
+// followed by exec() would, but without copying the caller's
+// memory. args, argc and len are as for exec(). The child's
+// file descriptor i is the caller's fds[i] for i < 3, or
+// closed if fds[i] < 0; it has no others.
+int
+spawn(char *path, char *args, int argc, int len, int *fds)
+{
+  int i, pid;
+  struct proc *np;
+  struct proc *p = myproc();
+
+  if((np = allocproc()) == 0){
+    return -1;
+  }
+  // no one else looks at np until it is RUNNABLE, and
+  // execproc() sleeps.
+  release(&np->lock);
+
+  memset(np->trapframe, 0, sizeof(*np->trapframe));
+  if(execproc(np, path, args, argc, len) < 0){
+    acquire(&np->lock);
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+  np->trapframe->a0 = argc;
+
+  for(i = 0; i < 3; i++)
+    if(fds[i] >= 0 && p->ofile[fds[i]])
+      np->ofile[i] = filedup(p->ofile[fds[i]]);
+  np->cwd = idup(p->cwd);
+  np->sctrace = p->sctrace;
+  np->profgen = p->profgen;
+
+  pid = np->pid;
+
+  acquire(&wait_lock);
+  setparent(np, p);
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  np->state = RUNNABLE;
+  release(&np->lock);
+
+  return pid;
+}
+
+// Create a thread: a process that uses the caller's memory
+// and starts by calling fn(arg) on the user stack that ends at
+// stack. fn must not return; the thread ends with exit(). The
+// thread gets its own copies of the caller's open file
+// descriptors and current directory, as from fork(), and the
+// caller can wait() for it.
+//
+// The thread's user page table shares the page-table page
+// that maps all of user memory (it lies below PLIC, so in the
+// first 1 GB, under root entry 0), and the per-process kernel
+// page table is shared outright, so changes made by one thread
+// are seen by all. Only the pages above, the trampoline, the
+// trapframe and USYSCALL, are the thread's own.
+int
+clone(uint64 fn, uint64 arg, uint64 stack)
+{
+  int i, pid;
+  struct proc *np;
+  struct proc *p = myproc();
+  struct proc *mm = p->mm;
+
+  if(stack % 16 != 0 || (mm->pagetable[0] & PTE_V) == 0)
+    return -1;
+  if((np = allocproc()) == 0){
+    return -1;
+  }
+  proc_free_kernel_pagetable(np->kernel_pagetable);
+  np->kernel_pagetable = mm->kernel_pagetable;
+  np->pagetable[0] = mm->pagetable[0];
+  np->mm = mm;
+
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->a0 = arg;
+  np->trapframe->sp = stack;
+  np->trapframe->ra = 0;
+
+  release(&np->lock);
+
+  acquire(&wait_lock);
+  if(killed(mm)){
+    // mm is in exit(), waiting for its threads to end.
+    release(&wait_lock);
+    detach(np);
+    acquire(&np->lock);
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+  mm->nthread++;
+  setparent(np, p);
+  release(&wait_lock);
+
+  for(i = 0; i < NOFILE; i++)
+    if(p->ofile[i])
+      np->ofile[i] = filedup(p->ofile[i]);
+  np->cwd = idup(p->cwd);
+
+  safestrcpy(np->name, p->name, sizeof(p->name));
+  np->sctrace = p->sctrace;
+  np->profgen = p->profgen;
+
+  pid = np->pid;
+
+  acquire(&np->lock);
+  np->state = RUNNABLE;
+  release(&np->lock);
+
+  return pid;
+}
+
+// Make thread p stop using the memory it shares, so that
+// freeproc() releases only what is p's own. An exiting thread
+// may still sleep or be preempted after this; the scheduler
+// then runs it on the global kernel page table, which maps
+// every kernel stack.
+static void
+detach(struct proc *p)
+{
+  if(p == myproc())
+    switch_kernel_pagetable(kernel_pagetable);
+  p->kernel_pagetable = 0;
+  p->pagetable[0] = 0;
+  p->mm = p;
+}
+
+// Make np a child of p.
+// Caller must hold wait_lock.
+static void
+setparent(struct proc *np, struct proc *p)
+{
+  np->parent = p;
+  np->sibling = p->children;
+  p->children = np;
+}
+
+// Wake p if it is sleeping on chan. Processes waiting for
+// children or threads sleep on themselves, so this finds them
+// without the search of all processes that wakeup() makes.
+// Caller must hold wait_lock.
+static void
+wakeproc(struct proc *p, void *chan)
+{
+  acquire(&p->lock);
+  if(p->state == SLEEPING && p->chan == chan){
+    p->state = RUNNABLE;
+    TRACE(TE_WAKEUP, p->pid, chan);
+  }
+  release(&p->lock);
+}
+
 // Pass p's abandoned children to init.
 // Caller must hold wait_lock.
 void
@@ -380,12 +742,17 @@ reparent(struct proc *p)
 {
   struct proc *pp;
 
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    if(pp->parent == p){
-      pp->parent = initproc;
-      wakeup(initproc);
-    }
+  if(p->children == 0)
+    return;
+  for(pp = p->children; ; pp = pp->sibling){
+    pp->parent = initproc;
+    if(pp->sibling == 0)
+      break;
   }
+  pp->sibling = initproc->children;
+  initproc->children = p->children;
+  p->children = 0;
+  wakeproc(initproc, initproc);
 }
 
 // Exit the current process.  Does not return.
@@ -395,6 +762,7 @@ void
 exit(int status)
 {
   struct proc *p = myproc();
+  struct proc *pp, *mm;
 
   if(p == initproc)
     panic("init exiting");
@@ -408,8 +776,37 @@ exit(int status)
     }
   }
 
+  if((mm = p->mm) != p){
+    // a thread: the memory is mm's, which waits in exit()
+    // for its threads to be done with it.
+    detach(p);
+    acquire(&wait_lock);
+    mm->nthread--;
+    wakeproc(mm, mm);
+    release(&wait_lock);
+  } else if(p->nthread > 1){
+    // end the threads using p's memory before it goes.
+    setkilled(p);
+    acquire(&wait_lock);
+    while(p->nthread > 1){
+      for(pp = proc; pp < &proc[NPROC]; pp++){
+        if(pp != p && pp->mm == p){
+          acquire(&pp->lock);
+          pp->killed = 1;
+          if(pp->state == SLEEPING)
+            pp->state = RUNNABLE;
+          release(&pp->lock);
+        }
+      }
+      sleep(p, &wait_lock);
+    }
+    release(&wait_lock);
+  }
+
+  vmunmapall(p);
   begin_op();
   iput(p->cwd);
+  vmaput(p->vma);
   end_op();
   p->cwd = 0;
 
@@ -419,7 +816,7 @@ exit(int status)
   reparent(p);
 
   // Parent might be sleeping in wait().
-  wakeup(p->parent);
+  wakeproc(p->parent, p->parent);
   
   acquire(&p->lock);
 
@@ -438,41 +835,42 @@ exit(int status)
 int
 wait(uint64 addr)
 {
-  struct proc *pp;
-  int havekids, pid;
+  struct proc *pp, **cp;
+  int pid;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(pp = proc; pp < &proc[NPROC]; pp++){
-      if(pp->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&pp->lock);
-
-        havekids = 1;
-        if(pp->state == ZOMBIE){
-          // Found one.
-          pid = pp->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
-                                  sizeof(pp->xstate)) < 0) {
-            release(&pp->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(pp);
+    // Scan through the children looking for exited ones.
+    for(cp = &p->children; (pp = *cp) != 0; cp = &pp->sibling){
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&pp->lock);
+
+      if(pp->state == ZOMBIE){
+        // Found one.
+        pid = pp->pid;
+        if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
+                                sizeof(pp->xstate)) < 0) {
           release(&pp->lock);
           release(&wait_lock);
-          return pid;
+          return -1;
         }
+        *cp = pp->sibling;
+        p->chpm.cycle += pp->hpm.cycle + pp->chpm.cycle;
+        p->chpm.instret += pp->hpm.instret + pp->chpm.instret;
+        p->cuhpm.cycle += pp->uhpm.cycle + pp->cuhpm.cycle;
+        p->cuhpm.instret += pp->uhpm.instret + pp->cuhpm.instret;
+        freeproc(pp);
         release(&pp->lock);
+        release(&wait_lock);
+        return pid;
       }
+      release(&pp->lock);
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || killed(p)){
+    if(p->children == 0 || killed(p)){
       release(&wait_lock);
       return -1;
     }
@@ -494,6 +892,7 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  uint64 run;
   
   c->proc = 0;
   for(;;){
@@ -508,9 +907,24 @@ scheduler(void)
         // before jumping back to us.
         p->state = RUNNING;
         c->proc = p;
-        switch_kernel_pagetable(p->kernel_pagetable);
+        c->nswitch++;
+        p->cpu = cpuid();
+        p->runstart = r_time();
+        p->hpmstart.cycle = r_cycle();
+        p->hpmstart.instret = r_instret();
+        p->tlbgen++;
+        TRACE(TE_SWITCHIN, p->pid, 0);
+        // a thread that detach() has cut loose from its
+        // memory runs on the global kernel page table.
+        switch_kernel_pagetable(p->kernel_pagetable ? p->kernel_pagetable : kernel_pagetable);
         swtch(&c->context, &p->context);
         switch_kernel_pagetable(kernel_pagetable);
+        TRACE(TE_SWITCHOUT, p->pid, p->state);
+        run = r_time() - p->runstart;
+        p->runtime += run;
+        p->hpm.cycle += r_cycle() - p->hpmstart.cycle;
+        p->hpm.instret += r_instret() - p->hpmstart.instret;
+        c->busy += run;
         // Process is done running for now.
         // It should have changed its p->state before coming back.
         c->proc = 0;
@@ -542,6 +956,10 @@ sched(void)
   if(intr_get())
     panic("sched interruptible");
 
+  if(p->state == SLEEPING)
+    p->nvcsw++;
+  else if(p->state == RUNNABLE)
+    p->nivcsw++;
   intena = mycpu()->intena;
   swtch(&p->context, &mycpu()->context);
   mycpu()->intena = intena;
@@ -599,6 +1017,7 @@ sleep(void *chan, struct spinlock *lk)
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  TRACE(TE_SLEEP, chan, 0);
 
   sched();
 
@@ -622,6 +1041,7 @@ wakeup(void *chan)
       acquire(&p->lock);
       if(p->state == SLEEPING && p->chan == chan) {
         p->state = RUNNABLE;
+        TRACE(TE_WAKEUP, p->pid, chan);
       }
       release(&p->lock);
     }
@@ -636,20 +1056,15 @@ kill(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      return 0;
-    }
-    release(&p->lock);
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->killed = 1;
+  if(p->state == SLEEPING){
+    // Wake process from sleep().
+    p->state = RUNNABLE;
   }
-  return -1;
+  release(&p->lock);
+  return 0;
 }
 
 void
@@ -701,6 +1116,102 @@ either_copyin(void *dst, int user_src, uint64 src, uint64 len)
   }
 }
 
+// Copy a struct procinfo for each process, up to n of them,
+// to the array at addr. Returns how many were copied, or -1.
+int
+getprocinfo(uint64 addr, int n)
+{
+  struct proc *p;
+  struct procinfo pi;
+  uint64 run;
+  int i;
+
+  i = 0;
+  for(p = proc; p < &proc[NPROC] && i < n; p++){
+    acquire(&wait_lock);
+    acquire(&p->lock);
+    if(p->state == UNUSED){
+      release(&p->lock);
+      release(&wait_lock);
+      continue;
+    }
+    pi.pid = p->pid;
+    pi.ppid = p->parent ? p->parent->pid : 0;
+    pi.state = p->state;
+    pi.cpu = p->cpu;
+    run = p->runtime;
+    if(p->state == RUNNING)
+      run += r_time() - p->runstart;
+    pi.utime = p->utime / (TIMEBASE / 1000000);
+    pi.stime = (run > p->utime ? run - p->utime : 0) / (TIMEBASE / 1000000);
+    pi.nvcsw = p->nvcsw;
+    pi.nivcsw = p->nivcsw;
+    pi.nfault = p->nfault;
+    pi.nsyscall = p->nsyscall;
+    pi.sz = p->mm->sz;
+    safestrcpy(pi.name, p->name, sizeof(pi.name));
+    release(&p->lock);
+    release(&wait_lock);
+    if(copyout(myproc()->pagetable, addr + i*sizeof(pi), (char*)&pi, sizeof(pi)) < 0)
+      return -1;
+    i++;
+  }
+  return i;
+}
+
+// Copy the performance counts of process pid (the caller, if
+// pid is 0) into *pi. Returns 0, or -1 if there is no such
+// process.
+int
+perfget(int pid, struct perfinfo *pi)
+{
+  struct proc *p;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+  acquire(&wait_lock);
+  if((p = findproc(pid)) == 0){
+    release(&wait_lock);
+    return -1;
+  }
+  pi->cycles = p->hpm.cycle;
+  pi->instret = p->hpm.instret;
+  if(p == myproc()){
+    // this CPU's counters have run on since p started running.
+    pi->cycles += r_cycle() - p->hpmstart.cycle;
+    pi->instret += r_instret() - p->hpmstart.instret;
+  }
+  pi->ucycles = p->uhpm.cycle;
+  pi->uinstret = p->uhpm.instret;
+  pi->ccycles = p->chpm.cycle;
+  pi->cinstret = p->chpm.instret;
+  pi->cucycles = p->cuhpm.cycle;
+  pi->cuinstret = p->cuhpm.instret;
+  release(&p->lock);
+  release(&wait_lock);
+  return 0;
+}
+
+// Format per-CPU counters for the statistics device, times
+// in milliseconds.
+int
+cpustats(char *buf, int sz)
+{
+  struct cpu *c;
+  int n;
+  uint64 ms = TIMEBASE / 1000, now = r_time();
+
+  n = 0;
+  for(c = cpus; c < &cpus[NCPU] && n < sz; c++){
+    if(c->nswitch == 0)
+      continue;
+    n += snprintf(buf + n, sz - n, "cpu%d: user %d sys %d idle %d switches %d syscalls %d faults %d\n",
+                  (int)(c - cpus), (int)(c->utime / ms), (int)((c->busy - c->utime) / ms),
+                  (int)((now - c->busy) / ms), c->nswitch, c->nsyscall, c->nfault);
+  }
+  return n;
+}
+
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
 // No lock to avoid wedging a stuck machine further.
@@ -727,6 +1238,10 @@ procdump(void)
     else
       state = "???";
     printf("%d %s %s", p->pid, state, p->name);
+    printf(" user %dms sys %dms switches %d/%d faults %d syscalls %d",
+           (int)(p->utime / (TIMEBASE / 1000)),
+           (int)((p->runtime > p->utime ? p->runtime - p->utime : 0) / (TIMEBASE / 1000)),
+           p->nvcsw, p->nivcsw, p->nfault, p->nsyscall);
     printf("\n");
   }
 }
@@ -24,6 +24,11 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  uint64 busy;                // Cycles spent running processes,
+  uint64 utime;               // of them in user space.
+  uint nswitch;               // Switches to a process.
+  uint nsyscall;              // System calls and page faults
+  uint nfault;                // taken from user space.
 };
 
 extern struct cpu cpus[NCPU];
@@ -79,6 +84,26 @@ struct trapframe {
   /* 280 */ uint64 t6;
 };
 
+// A region of user memory whose pages are filled in on first
+// use by vmfault(): from a file, where ip is set, and with
+// zeros beyond filesz. Regions from exec() lie below p->sz;
+// regions from mmap() lie above it, below MMAPTOP.
+struct vma {
+  uint64 start;
+  uint64 end;                  // 0 if the slot is unused
+  int perm;                    // PTE_R, PTE_W, PTE_X
+  int flags;                   // MAP_SHARED or MAP_PRIVATE; 0 for exec()
+  struct inode *ip;            // backing file, or 0
+  uint off;                    // file offset of start
+  uint filesz;                 // bytes of the file mapped at start
+};
+
+// Hardware performance counts.
+struct hpmcount {
+  uint64 cycle;
+  uint64 instret;
+};
+
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
@@ -92,8 +117,13 @@ struct proc {
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
 
-  // wait_lock must be held when using this:
+  // wait_lock must be held when using these:
   struct proc *parent;         // Parent process
+  struct proc *children;       // First child
+  struct proc *sibling;        // Next child of the same parent
+
+  struct proc *next;           // Next on the free list if UNUSED,
+                               // else in the pid's hash chain
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
@@ -101,8 +131,42 @@ struct proc {
   pagetable_t pagetable;       // User page table
   pagetable_t kernel_pagetable; // Copy of the kernel_pagetable
   struct trapframe *trapframe; // data page for trampoline.S
+#ifdef LAB_PGTBL
+  struct usyscall *usyscall;   // data page mapped read-only at USYSCALL
+#endif
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
+  struct vma vma[NVMA];        // Demand-paged regions
+  struct proc *mm;             // Whose memory, sz and vma[] to use: this
+                               // process, or the one whose thread it is
+  int nthread;                 // If mm is this process, threads using its
+                               // memory, itself included (under wait_lock)
+  struct spinlock vmlk;        // protects vmbusy
+  int vmbusy;                  // is a thread changing the memory? (vmlock())
+  uint tlbgen;                 // bumped each time p's CPU flushes its TLB
+  uint64 sctrace;              // system calls to print, by bit (trace())
+  uint profgen;                // profile() run that p was started in, if any
+  int swapok;                  // May swap.c take pages now? (read under p->lock)
+  uint64 swaphand;             // swap.c's CLOCK hand within this process
+  uint64 runtime;              // cycles spent running (under p->lock)
+  uint64 runstart;             // when the process last started running
+  uint64 utime;                // of runtime, cycles spent in user space
+  uint64 userstart;            // when the process last entered user space
+  uint nvcsw;                  // switches away while sleeping (under p->lock)
+  uint nivcsw;                 // and while still runnable
+  uint nfault;                 // page faults and system calls, counted by
+  uint nsyscall;               // the process itself
+  int cpu;                     // CPU it last ran on (under p->lock)
+  struct hpmcount hpm;         // counts while running (under p->lock)
+  struct hpmcount uhpm;        // of them, in user space
+  struct hpmcount chpm;        // hpm and uhpm of reaped children,
+  struct hpmcount cuhpm;       // and theirs (under wait_lock)
+  struct hpmcount hpmstart;    // counters when last switched to
+  struct hpmcount uhpmstart;   // and when last returned to user space
+  uint wstick;                 // when the working set was last sampled
+  uint64 wsresident;           // and what it was (wset.c; under p->lock)
+  uint64 wstouched;
+  uint64 wsswapped;
   char name[16];               // Process name (debugging)
 };
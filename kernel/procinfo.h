@@ -0,0 +1,15 @@
+// A process's CPU accounting, as getprocinfo() reports it.
+struct procinfo {
+  int pid;
+  int ppid;             // parent's pid, 0 if none
+  int state;            // enum procstate in proc.h
+  int cpu;              // CPU it last ran on
+  uint64 utime;         // microseconds spent running in user space
+  uint64 stime;         // and in the kernel
+  uint nvcsw;           // switches away while sleeping
+  uint nivcsw;          // and while still runnable
+  uint nfault;          // page faults
+  uint nsyscall;        // system calls
+  uint64 sz;            // bytes of memory below the heap top
+  char name[16];
+};
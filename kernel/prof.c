@@ -0,0 +1,167 @@
+//
+// Sampling profiler. While profiling is on, the timer
+// interrupts profrate times per clock tick; each interrupt
+// records the interrupted pc, process and CPU in that CPU's
+// ring of samples, and only every profrate'th counts as a
+// tick. Reading the profile device takes samples out of the
+// rings, as struct profsample (see prof.h).
+//
+// profile(rate) starts profiling at rate samples per tick,
+// emptying the rings, or stops it if rate is 0. While it is
+// off, devintr() pays one test of profrate per interrupt.
+// Starting it also gives the caller a new profgen, which fork(),
+// spawn() and clone() pass on, so that samples of the caller
+// and the processes it starts can be told from the rest.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "fs.h"
+#include "file.h"
+#include "prof.h"
+#include "defs.h"
+
+extern uint64 timer_scratch[NCPU][5];   // start.c
+
+int profrate;                           // samples per tick; 0 if off
+uint profgen;                           // bumped by each profile(rate > 0)
+
+struct {
+  struct spinlock lock;
+  struct profsample buf[NPROFSAMPLE];
+  int head;                             // oldest sample
+  int n;
+  int sub;                              // interrupts since the last tick
+  int taken;
+  int dropped;                          // for want of room
+} profcpu[NCPU];
+
+// A timer interrupt while profiling: sample what it
+// interrupted. Returns 1 if the interrupt is a clock tick too.
+// Interrupts are off.
+int
+profintr(void)
+{
+  struct cpu *c = mycpu();
+  struct profsample *s;
+  int id = cpuid();
+
+  acquire(&profcpu[id].lock);
+  if(profcpu[id].n < NPROFSAMPLE){
+    s = &profcpu[id].buf[(profcpu[id].head + profcpu[id].n) % NPROFSAMPLE];
+    s->pc = r_sepc();
+    s->pid = c->proc ? c->proc->pid : 0;
+    s->cpu = id;
+    s->flags = 0;
+    if((r_sstatus() & SSTATUS_SPP) == 0)
+      s->flags |= PS_USER;
+    if(c->proc && c->proc->profgen == profgen)
+      s->flags |= PS_TREE;
+    profcpu[id].n++;
+    profcpu[id].taken++;
+  } else {
+    profcpu[id].dropped++;
+  }
+  release(&profcpu[id].lock);
+
+  if(++profcpu[id].sub < profrate)
+    return 0;
+  profcpu[id].sub = 0;
+  return 1;
+}
+
+// Start profiling at rate samples per clock tick, or stop if
+// rate is 0.
+int
+profile(int rate)
+{
+  int i;
+
+  if(rate < 0 || rate > PROFMAXRATE)
+    return -1;
+  if(rate > 0){
+    for(i = 0; i < NCPU; i++){
+      acquire(&profcpu[i].lock);
+      profcpu[i].head = 0;
+      profcpu[i].n = 0;
+      profcpu[i].sub = 0;
+      profcpu[i].taken = 0;
+      profcpu[i].dropped = 0;
+      release(&profcpu[i].lock);
+    }
+    myproc()->profgen = ++profgen;
+  }
+  profrate = rate;
+  // timervec reads the interval from here for the next
+  // interrupt after the one already set.
+  for(i = 0; i < NCPU; i++)
+    timer_scratch[i][4] = TICKCYCLES / (rate > 0 ? rate : 1);
+  return 0;
+}
+
+static int
+profwrite(int user_src, uint64 src, int n)
+{
+  return -1;
+}
+
+// Take whole samples out of the rings, up to n bytes. Returns
+// 0 when there are none left.
+static int
+profread(int user_dst, uint64 dst, int n)
+{
+  struct profsample batch[16];
+  int i, m, tot;
+
+  tot = 0;
+  for(i = 0; i < NCPU; i++){
+    for(;;){
+      // copy out without the lock, since that may sleep.
+      acquire(&profcpu[i].lock);
+      for(m = 0; m < NELEM(batch) && m < profcpu[i].n &&
+            tot + (m+1)*sizeof(batch[0]) <= n; m++){
+        batch[m] = profcpu[i].buf[profcpu[i].head];
+        profcpu[i].head = (profcpu[i].head + 1) % NPROFSAMPLE;
+      }
+      profcpu[i].n -= m;
+      release(&profcpu[i].lock);
+      if(m == 0)
+        break;
+      if(either_copyout(user_dst, dst + tot, batch, m*sizeof(batch[0])) < 0)
+        return -1;
+      tot += m*sizeof(batch[0]);
+    }
+  }
+  return tot;
+}
+
+// Format profiler counters for the statistics device.
+int
+profstats(char *buf, int sz)
+{
+  int i, taken, dropped;
+
+  taken = dropped = 0;
+  for(i = 0; i < NCPU; i++){
+    taken += profcpu[i].taken;
+    dropped += profcpu[i].dropped;
+  }
+  return snprintf(buf, sz, "prof: rate %d samples %d dropped %d\n",
+                  profrate, taken, dropped);
+}
+
+void
+profinit(void)
+{
+  int i;
+
+  for(i = 0; i < NCPU; i++)
+    initlock(&profcpu[i].lock, "prof");
+  devsw[PROF].read = profread;
+  devsw[PROF].write = profwrite;
+}
@@ -0,0 +1,11 @@
+// A profiling sample, as read from the profile device.
+struct profsample {
+  uint64 pc;       // sepc when the timer interrupted
+  int pid;         // process running then, 0 if none
+  short cpu;
+  short flags;
+};
+
+#define PS_USER  1   // pc is a user address
+#define PS_TREE  2   // the process is profile()'s caller, or one
+                     // it started after profiling began
@@ -0,0 +1,10 @@
+#define NSCBUCKET 32
+
+// A system call's count and latencies, summed over the CPUs,
+// as syscallstat() reports them.
+struct scstat {
+  uint64 count;
+  uint64 cycles;             // timer cycles spent in it, in all
+  uint hist[NSCBUCKET];      // hist[b]: calls that took less than
+                             // 2^b cycles, and at least 2^(b-1)
+};
@@ -0,0 +1,215 @@
+// Slab allocator for small kernel objects.
+//
+// A cache (struct kmem_cache, see slab.h) hands out objects of
+// one size. Its objects live in slabs: pages from kalloc() that
+// begin with a struct slab header followed by as many objects as
+// fit. Free objects within a slab are chained through their
+// first word.
+//
+// kmem_cache_alloc() and kmem_cache_free() work on the calling
+// CPU's magazine with interrupts off. Only when the magazine is
+// empty (or full) do they take the cache lock and move half a
+// magazine's worth of objects from (or back to) the slabs.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "slab.h"
+#include "defs.h"
+
+struct slab {
+  struct slab *next;
+  struct slab *prev;
+  struct kmem_cache *cache;
+  uint nfree;             // free objects in this slab
+  void *freelist;         // first free object
+};
+
+#define SLABHDR ((sizeof(struct slab) + 7) & ~7)
+
+// All caches, for slabstats(). Caches are created during boot,
+// before the other CPUs start, so the list needs no lock.
+static struct kmem_cache *caches;
+
+static void
+slab_push(struct slab **list, struct slab *s)
+{
+  s->prev = 0;
+  s->next = *list;
+  if(*list)
+    (*list)->prev = s;
+  *list = s;
+}
+
+static void
+slab_remove(struct slab **list, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    *list = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+}
+
+void
+kmem_cache_init(struct kmem_cache *c, char *name, uint size)
+{
+  size = (size + 7) & ~7;
+  if(size + SLABHDR > PGSIZE)
+    panic("kmem_cache_init: object too large");
+  initlock(&c->lock, name);
+  c->name = name;
+  c->size = size;
+  c->perslab = (PGSIZE - SLABHDR) / size;
+  c->partial = c->full = c->empty = 0;
+  memset(c->mag, 0, sizeof(c->mag));
+  c->nslab = 0;
+  c->nrefill = 0;
+  c->next = caches;
+  caches = c;
+}
+
+// Set up a fresh page as an empty slab of c.
+static struct slab*
+slab_new(struct kmem_cache *c)
+{
+  struct slab *s;
+  char *o;
+  int i;
+
+  if((s = (struct slab*)kalloc()) == 0)
+    return 0;
+  s->cache = c;
+  s->nfree = c->perslab;
+  s->freelist = 0;
+  o = (char*)s + SLABHDR;
+  for(i = c->perslab - 1; i >= 0; i--){
+    *(void**)(o + i*c->size) = s->freelist;
+    s->freelist = o + i*c->size;
+  }
+  c->nslab++;
+  return s;
+}
+
+// Take one object from c's slabs.
+// Caller holds c->lock.
+static void*
+slab_get(struct kmem_cache *c)
+{
+  struct slab *s;
+  void *o;
+
+  if((s = c->partial) == 0){
+    if((s = c->empty) != 0)
+      c->empty = 0;
+    else if((s = slab_new(c)) == 0)
+      return 0;
+    slab_push(&c->partial, s);
+  }
+  o = s->freelist;
+  s->freelist = *(void**)o;
+  if(--s->nfree == 0){
+    slab_remove(&c->partial, s);
+    slab_push(&c->full, s);
+  }
+  return o;
+}
+
+// Return object o to its slab. Keeps at most one empty slab
+// and gives the pages of any others back to kalloc.
+// Caller holds c->lock.
+static void
+slab_put(struct kmem_cache *c, void *o)
+{
+  struct slab *s = (struct slab*)PGROUNDDOWN((uint64)o);
+
+  if(s->cache != c)
+    panic("kmem_cache_free: wrong cache");
+  if(s->nfree == 0){
+    slab_remove(&c->full, s);
+    slab_push(&c->partial, s);
+  }
+  *(void**)o = s->freelist;
+  s->freelist = o;
+  if(++s->nfree == c->perslab){
+    slab_remove(&c->partial, s);
+    if(c->empty == 0){
+      c->empty = s;
+    } else {
+      c->nslab--;
+      kfree((void*)s);
+    }
+  }
+}
+
+// Allocate an object from c. Its contents are undefined.
+// Returns 0 if memory cannot be allocated.
+void*
+kmem_cache_alloc(struct kmem_cache *c)
+{
+  struct magazine *m;
+  void *o;
+
+  push_off();
+  m = &c->mag[cpuid()];
+  if(m->n == 0){
+    acquire(&c->lock);
+    c->nrefill++;
+    while(m->n < MAGSIZE/2 && (o = slab_get(c)) != 0)
+      m->obj[m->n++] = o;
+    release(&c->lock);
+    if(m->n == 0){
+      pop_off();
+      return 0;
+    }
+  }
+  o = m->obj[--m->n];
+  m->nalloc++;
+  pop_off();
+  return o;
+}
+
+// Free an object that kmem_cache_alloc(c) returned.
+void
+kmem_cache_free(struct kmem_cache *c, void *o)
+{
+  struct magazine *m;
+
+  push_off();
+  m = &c->mag[cpuid()];
+  if(m->n == MAGSIZE){
+    acquire(&c->lock);
+    while(m->n > MAGSIZE/2)
+      slab_put(c, m->obj[--m->n]);
+    release(&c->lock);
+  }
+  m->obj[m->n++] = o;
+  m->nfree++;
+  pop_off();
+}
+
+// Write one line of statistics per cache into buf.
+// Returns the number of bytes written.
+int
+slabstats(char *buf, int sz)
+{
+  struct kmem_cache *c;
+  uint64 nalloc, nfree;
+  int i, n = 0;
+
+  for(c = caches; c != 0 && n < sz; c = c->next){
+    nalloc = nfree = 0;
+    for(i = 0; i < NCPU; i++){
+      nalloc += c->mag[i].nalloc;
+      nfree += c->mag[i].nfree;
+    }
+    n += snprintf(buf+n, sz-n,
+                  "slab: %s size %d inuse %d slabs %d allocs %d refills %d\n",
+                  c->name, c->size, (int)(nalloc - nfree), c->nslab,
+                  (int)nalloc, (int)c->nrefill);
+  }
+  return n;
+}
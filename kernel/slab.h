@@ -0,0 +1,34 @@
+// Object cache for small, fixed-size kernel objects.
+//
+// Each cache carves whole pages from kalloc() into slabs of
+// equal-sized objects. A slab's header sits at the start of its
+// page, so an object's slab is found by rounding its address
+// down to a page boundary.
+//
+// Each CPU keeps a small magazine of free objects in front of
+// the slabs, so most allocations and frees neither take the
+// cache lock nor touch another CPU's cache lines.
+
+#define MAGSIZE 8   // objects per per-CPU magazine
+
+struct magazine {
+  int n;
+  void *obj[MAGSIZE];
+  uint64 nalloc;             // allocations on this CPU
+  uint64 nfree;              // frees on this CPU
+};
+
+struct kmem_cache {
+  struct spinlock lock;
+  char *name;
+  uint size;                 // object size, rounded up to 8 bytes
+  uint perslab;              // objects per slab
+  struct slab *partial;      // slabs with some free objects
+  struct slab *full;         // slabs with no free objects
+  struct slab *empty;        // at most one cached empty slab
+  struct magazine mag[NCPU];
+  struct kmem_cache *next;   // list of all caches, for statistics
+
+  uint nslab;                // slabs (pages) held by the cache
+  uint64 nrefill;            // magazine refills from the slabs
+};
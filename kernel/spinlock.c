@@ -108,3 +108,17 @@ pop_off(void)
   if(c->noff == 0 && c->intena)
     intr_on();
 }
+
+// Return 1 if the caller holds no spinlock, and so may sleep.
+// noff is read with interrupts off, so that it is this CPU's
+// count and not that of a CPU the caller was moved from.
+int
+cansleep(void)
+{
+  int r;
+
+  push_off();
+  r = mycpu()->noff == 1;
+  pop_off();
+  return r;
+}
@@ -43,6 +43,14 @@ start()
   w_pmpaddr0(0x3fffffffffffffull);
   w_pmpcfg0(0xf);
 
+  // let supervisor mode read the cycle, time and instret CSRs.
+  w_mcounteren(r_mcounteren() | COUNTEREN_CY | COUNTEREN_TM | COUNTEREN_IR);
+
+  // and user mode too: bench times itself with rdtime, which
+  // traps unless TM is set here, and programs may read cycle
+  // and instret directly (see perfinfo()).
+  w_scounteren(r_scounteren() | COUNTEREN_CY | COUNTEREN_TM | COUNTEREN_IR);
+
   // ask for clock interrupts.
   timerinit();
 
@@ -66,7 +74,7 @@ timerinit()
   int id = r_mhartid();
 
   // ask the CLINT for a timer interrupt.
-  int interval = 1000000; // cycles; about 1/10th second in qemu.
+  int interval = TICKCYCLES; // about 1/10th second in qemu.
   *(uint64*)CLINT_MTIMECMP(id) = *(uint64*)CLINT_MTIME + interval;
 
   // prepare information in scratch[] for timervec.
@@ -0,0 +1,80 @@
+//
+// The statistics device: reading it returns a text snapshot of
+// kernel counters, one "subsystem: ..." line per counter.
+// Each read of a snapshot continues where the last one left
+// off; the read after the last byte returns 0 (end of file),
+// and the next read starts a fresh snapshot.
+//
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "riscv.h"
+#include "defs.h"
+
+#define BUFSZ 4096
+static struct {
+  struct spinlock lock;
+  char buf[BUFSZ];
+  int sz;
+  int off;
+} stats;
+
+int
+statswrite(int user_src, uint64 src, int n)
+{
+  return -1;
+}
+
+int
+statsread(int user_dst, uint64 dst, int n)
+{
+  int m;
+
+  acquire(&stats.lock);
+
+  if(stats.sz > 0 && stats.off >= stats.sz) {
+    // end of this snapshot.
+    stats.sz = 0;
+    stats.off = 0;
+    release(&stats.lock);
+    return 0;
+  }
+
+  if(stats.sz == 0) {
+    stats.sz += kallocstats(stats.buf+stats.sz, BUFSZ-stats.sz);
+    stats.sz += slabstats(stats.buf+stats.sz, BUFSZ-stats.sz);
+    stats.sz += pcachestats(stats.buf+stats.sz, BUFSZ-stats.sz);
+    stats.sz += swapstats(stats.buf+stats.sz, BUFSZ-stats.sz);
+    stats.sz += cpustats(stats.buf+stats.sz, BUFSZ-stats.sz);
+    stats.sz += profstats(stats.buf+stats.sz, BUFSZ-stats.sz);
+    stats.sz += tracestats(stats.buf+stats.sz, BUFSZ-stats.sz);
+    stats.sz += klogstats(stats.buf+stats.sz, BUFSZ-stats.sz);
+  }
+  m = stats.sz - stats.off;
+
+  if (m > 0) {
+    if(m > n)
+      m  = n;
+    if(either_copyout(user_dst, dst, stats.buf+stats.off, m) != -1) {
+      stats.off += m;
+    } else {
+      m = -1;
+    }
+  }
+
+  release(&stats.lock);
+  return m;
+}
+
+void
+statsinit(void)
+{
+  initlock(&stats.lock, "stats");
+
+  devsw[STATS].read = statsread;
+  devsw[STATS].write = statswrite;
+}
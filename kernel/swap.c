@@ -0,0 +1,260 @@
+//
+// Swapping: when kalloc() runs out of pages, swapreclaim()
+// writes a user page that has not been used lately to the
+// swap area at the end of the disk (see mkfs) and frees it.
+//
+// Pages are chosen by the CLOCK algorithm. A hand sweeps over
+// the processes and, within each, over its memory; a page whose
+// PTE_A (or PTE_SA) bit is set has been used since the hand last
+// passed, so the bit is cleared and the page skipped.
+//
+// A swapped-out page's PTE has PTE_V clear, PTE_S set, and the
+// number of its swap slot where the physical page number would
+// be; the other flags are kept. The page is removed from the
+// per-process kernel page table too. vmfault() reads it back.
+//
+// Only pages that the kernel holds no pointers to may go: those
+// of a process without threads that has set p->swapok and is
+// not running on another CPU. Megapages, read-only pages, pages shared with
+// other processes or the page cache, and pages of MAP_SHARED
+// regions are never swapped out.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "fs.h"
+#include "buf.h"
+#include "fcntl.h"
+#include "vm.h"
+#include "defs.h"
+
+#define BPP (PGSIZE / BSIZE)   // blocks per page
+#define NSLOT (NSWAP / BPP)
+
+#define PTE2SLOT(pte) ((uint)((pte) >> 10))
+#define SLOT2PTE(s) ((uint64)(s) << 10)
+
+extern struct proc proc[NPROC];
+
+struct {
+  struct sleeplock lock;   // serializes swap I/O and the CLOCK hand
+  struct spinlock reflock; // protects ref[] and nused
+  uint dev;
+  uint start;              // first block of the swap area
+  int nslot;               // 0 until swapinit()
+  uchar ref[NSLOT];        // PTEs naming each slot
+  struct buf buf[BPP];     // private, so swapping bypasses bio
+  int hand;                // CLOCK hand: index into proc[]
+  int nused;
+  int nin;
+  int nout;
+} swap;
+
+// Called by fsinit() with the swap area of the root disk.
+void
+swapinit(uint dev, uint start, uint nblocks)
+{
+  initsleeplock(&swap.lock, "swap");
+  initlock(&swap.reflock, "swapref");
+  swap.dev = dev;
+  swap.start = start;
+  swap.nslot = nblocks / BPP < NSLOT ? nblocks / BPP : NSLOT;
+}
+
+// Return a free slot with one reference, or -1.
+static int
+slotalloc(void)
+{
+  int s;
+
+  acquire(&swap.reflock);
+  for(s = 0; s < swap.nslot; s++){
+    if(swap.ref[s] == 0){
+      swap.ref[s] = 1;
+      swap.nused++;
+      release(&swap.reflock);
+      return s;
+    }
+  }
+  release(&swap.reflock);
+  return -1;
+}
+
+static void
+slotput(uint s)
+{
+  acquire(&swap.reflock);
+  if(s >= swap.nslot || swap.ref[s] == 0)
+    panic("swap: bad slot");
+  if(--swap.ref[s] == 0)
+    swap.nused--;
+  release(&swap.reflock);
+}
+
+// fork() has copied pte, a swapped-out PTE, to a child.
+void
+swapdup(pte_t pte)
+{
+  acquire(&swap.reflock);
+  if(PTE2SLOT(pte) >= swap.nslot || swap.ref[PTE2SLOT(pte)] == 0)
+    panic("swapdup");
+  swap.ref[PTE2SLOT(pte)]++;
+  release(&swap.reflock);
+}
+
+// Drop a swapped-out PTE that is being unmapped.
+void
+swapfree(pte_t pte)
+{
+  slotput(PTE2SLOT(pte));
+}
+
+// Read or write the page at pa from or to slot s.
+// Caller holds swap.lock.
+static void
+swaprw(uint s, char *pa, int write)
+{
+  struct buf *b;
+  int i;
+
+  for(i = 0; i < BPP; i++){
+    b = &swap.buf[i];
+    b->dev = swap.dev;
+    b->blockno = swap.start + s*BPP + i;
+    if(write)
+      memmove(b->data, pa + i*BSIZE, BSIZE);
+    virtio_disk_rw(b, write);
+    if(!write)
+      memmove(pa + i*BSIZE, b->data, BSIZE);
+  }
+}
+
+// Look over q's pages in [start, end) that are on this pass
+// of the hand: at or above q->swaphand on the first, below it
+// on the second. Returns the PTE of one that may be swapped out
+// and sets *va, clearing PTE_A of those passed over.
+// Caller holds q->lock.
+static pte_t*
+scan(struct proc *q, uint64 start, uint64 end, int pass, uint64 *va)
+{
+  struct vmwalk w;
+
+  if(pass == 0 && start < q->swaphand)
+    start = q->swaphand;
+  if(pass == 1 && end > q->swaphand)
+    end = q->swaphand;
+  for(vmwalk_init(&w, q->pagetable, start, end, 0); vmwalk_next(&w); ){
+    if(w.pte == 0 || w.level != 0)
+      continue;
+    if((*w.pte & (PTE_V|PTE_U|PTE_W)) != (PTE_V|PTE_U|PTE_W))
+      continue;
+    if(kref((void*)PTE2PA(*w.pte)) != 1)
+      continue;
+    if(*w.pte & (PTE_A|PTE_SA)){
+      *w.pte &= ~(PTE_A|PTE_SA);
+      continue;
+    }
+    *va = w.va;
+    return w.pte;
+  }
+  return 0;
+}
+
+// Find a page of q to swap out, or return 0.
+// Caller holds q->lock.
+static pte_t*
+victim(struct proc *q, uint64 *va)
+{
+  struct vma *v;
+  pte_t *pte;
+  int pass;
+
+  for(pass = 0; pass < 2; pass++){
+    if((pte = scan(q, 0, q->sz, pass, va)) != 0)
+      return pte;
+    for(v = q->vma; v < q->vma + NVMA; v++)
+      if(v->end != 0 && v->flags == MAP_PRIVATE &&
+         (pte = scan(q, v->start, v->end, pass, va)) != 0)
+        return pte;
+  }
+  return 0;
+}
+
+// Swap out one page, to give kalloc() memory.
+// Returns 1 if a page was freed, 0 if none could be.
+// Does nothing if the caller may not sleep.
+int
+swapreclaim(void)
+{
+  struct proc *p = myproc(), *q;
+  pte_t *pte;
+  uint64 va, pa;
+  int i, s;
+
+  if(p == 0 || !cansleep() || swap.nslot == 0)
+    return 0;
+  if((s = slotalloc()) < 0)
+    return 0;
+
+  acquiresleep(&swap.lock);
+  // twice round, since the first time may only clear PTE_A bits.
+  for(i = 0; i <= 2*NPROC; i++){
+    q = &proc[swap.hand];
+    acquire(&q->lock);
+    // the pages of a process with threads may be in use on
+    // any of several CPUs.
+    if(q->swapok && q->mm == q && q->nthread == 1 &&
+       (q == p || q->state == RUNNABLE || q->state == SLEEPING) &&
+       (pte = victim(q, &va)) != 0){
+      pa = PTE2PA(*pte);
+      *pte = SLOT2PTE(s) | (PTE_FLAGS(*pte) & ~PTE_V) | PTE_S;
+      clear_pte(q->kernel_pagetable, va, va + PGSIZE);
+      q->swaphand = va + PGSIZE;
+      if(q == p)
+        sfence_vma();
+      // q cannot reach the page any more; if it faults on it,
+      // swapin() waits for swap.lock, so for the write.
+      release(&q->lock);
+      swaprw(s, (char*)pa, 1);
+      kfree((void*)pa);
+      swap.nout++;
+      releasesleep(&swap.lock);
+      return 1;
+    }
+    release(&q->lock);
+    swap.hand = (swap.hand + 1) % NPROC;
+  }
+  releasesleep(&swap.lock);
+  slotput(s);
+  return 0;
+}
+
+// Read the page that swapped-out PTE pte names into mem,
+// and drop the PTE's reference to its slot.
+void
+swapin(pte_t pte, char *mem)
+{
+  acquiresleep(&swap.lock);
+  swaprw(PTE2SLOT(pte), mem, 0);
+  swap.nin++;
+  releasesleep(&swap.lock);
+  slotput(PTE2SLOT(pte));
+}
+
+// Format swap counters for the statistics device.
+int
+swapstats(char *buf, int sz)
+{
+  int n;
+
+  acquire(&swap.reflock);
+  n = snprintf(buf, sz, "swap: slots %d used %d in %d out %d\n",
+               swap.nslot, swap.nused, swap.nin, swap.nout);
+  release(&swap.reflock);
+  return n;
+}
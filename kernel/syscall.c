@@ -5,6 +5,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "syscall.h"
+#include "scstat.h"
 #include "defs.h"
 
 // Fetch the uint64 at addr from the current process.
@@ -12,7 +13,7 @@ int
 fetchaddr(uint64 addr, uint64 *ip)
 {
   struct proc *p = myproc();
-  if(addr >= p->sz || addr+sizeof(uint64) > p->sz) // both tests needed, in case of overflow
+  if(addr >= p->mm->sz || addr+sizeof(uint64) > p->mm->sz) // both tests needed, in case of overflow
     return -1;
   if(copyin(p->pagetable, (char *)ip, addr, sizeof(*ip)) != 0)
     return -1;
@@ -20,13 +21,16 @@ fetchaddr(uint64 addr, uint64 *ip)
 }
 
 // Fetch the nul-terminated string at addr from the current process.
-// Returns length of string, not including nul, or -1 for error.
+// Returns length of string, not including nul, -1 for a bad
+// address, or -2 if the string does not fit in max bytes.
 int
 fetchstr(uint64 addr, char *buf, int max)
 {
   struct proc *p = myproc();
-  if(copyinstr(p->pagetable, buf, addr, max) < 0)
-    return -1;
+  int r;
+
+  if((r = copyinstr(p->pagetable, buf, addr, max)) < 0)
+    return r;
   return strlen(buf);
 }
 
@@ -101,6 +105,19 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_link(void);
 extern uint64 sys_mkdir(void);
 extern uint64 sys_close(void);
+extern uint64 sys_mmap(void);
+extern uint64 sys_munmap(void);
+extern uint64 sys_wsinfo(void);
+extern uint64 sys_spawn(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_futex_wait(void);
+extern uint64 sys_futex_wake(void);
+extern uint64 sys_getprocinfo(void);
+extern uint64 sys_profile(void);
+extern uint64 sys_tracemask(void);
+extern uint64 sys_trace(void);
+extern uint64 sys_syscallstat(void);
+extern uint64 sys_perfinfo(void);
 
 #ifdef LAB_NET
 extern uint64 sys_connect(void);
@@ -133,6 +150,19 @@ static uint64 (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_mmap]    sys_mmap,
+[SYS_munmap]  sys_munmap,
+[SYS_wsinfo]  sys_wsinfo,
+[SYS_spawn]   sys_spawn,
+[SYS_clone]   sys_clone,
+[SYS_futex_wait] sys_futex_wait,
+[SYS_futex_wake] sys_futex_wake,
+[SYS_getprocinfo] sys_getprocinfo,
+[SYS_profile] sys_profile,
+[SYS_tracemask] sys_tracemask,
+[SYS_trace]   sys_trace,
+[SYS_syscallstat] sys_syscallstat,
+[SYS_perfinfo] sys_perfinfo,
 #ifdef LAB_NET
 [SYS_connect] sys_connect,
 #endif
@@ -141,19 +171,109 @@ static uint64 (*syscalls[])(void) = {
 #endif
 };
 
+// Names for trace() to print.
+static char *syscallnames[] = {
+[SYS_fork]    "fork",
+[SYS_exit]    "exit",
+[SYS_wait]    "wait",
+[SYS_pipe]    "pipe",
+[SYS_read]    "read",
+[SYS_kill]    "kill",
+[SYS_exec]    "exec",
+[SYS_fstat]   "fstat",
+[SYS_chdir]   "chdir",
+[SYS_dup]     "dup",
+[SYS_getpid]  "getpid",
+[SYS_sbrk]    "sbrk",
+[SYS_sleep]   "sleep",
+[SYS_uptime]  "uptime",
+[SYS_open]    "open",
+[SYS_write]   "write",
+[SYS_mknod]   "mknod",
+[SYS_unlink]  "unlink",
+[SYS_link]    "link",
+[SYS_mkdir]   "mkdir",
+[SYS_close]   "close",
+[SYS_trace]   "trace",
+[SYS_mmap]    "mmap",
+[SYS_munmap]  "munmap",
+[SYS_connect] "connect",
+[SYS_pgaccess] "pgaccess",
+[SYS_wsinfo]  "wsinfo",
+[SYS_spawn]   "spawn",
+[SYS_clone]   "clone",
+[SYS_futex_wait] "futex_wait",
+[SYS_futex_wake] "futex_wake",
+[SYS_getprocinfo] "getprocinfo",
+[SYS_profile] "profile",
+[SYS_tracemask] "tracemask",
+[SYS_syscallstat] "syscallstat",
+[SYS_perfinfo] "perfinfo",
+};
+
+// Each CPU's counts and latency histograms, updated with
+// interrupts off by the CPU a call finishes on, so without a
+// lock.
+static struct scstat scstats[NCPU][NELEM(syscalls)];
+
+// Count a call of num that took cycles.
+static void
+account(int num, uint64 cycles)
+{
+  struct scstat *s;
+  uint64 d;
+  int b;
+
+  for(b = 0, d = cycles; d != 0 && b < NSCBUCKET - 1; b++)
+    d >>= 1;
+  push_off();
+  s = &scstats[cpuid()][num];
+  s->count++;
+  s->cycles += cycles;
+  s->hist[b]++;
+  pop_off();
+}
 
+// Copy the counts and histograms, summed over the CPUs, of
+// system calls 0 to n-1 to the struct scstat array at addr.
+// Returns how many system call numbers there are, or -1.
+int
+syscallstat(uint64 addr, int n)
+{
+  struct proc *p = myproc();
+  struct scstat s;
+  int num, c, b;
+
+  for(num = 0; num < n && num < NELEM(syscalls); num++){
+    memset(&s, 0, sizeof(s));
+    for(c = 0; c < NCPU; c++){
+      s.count += scstats[c][num].count;
+      s.cycles += scstats[c][num].cycles;
+      for(b = 0; b < NSCBUCKET; b++)
+        s.hist[b] += scstats[c][num].hist[b];
+    }
+    if(copyout(p->pagetable, addr + num*sizeof(s), (char*)&s, sizeof(s)) < 0)
+      return -1;
+  }
+  return NELEM(syscalls);
+}
 
 void
 syscall(void)
 {
   int num;
   struct proc *p = myproc();
+  uint64 start;
 
   num = p->trapframe->a7;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
     // Use num to lookup the system call function for num, call it,
     // and store its return value in p->trapframe->a0
+    start = r_time();
     p->trapframe->a0 = syscalls[num]();
+    account(num, r_time() - start);
+    if(p->sctrace & (1L << num))
+      printf("%d: syscall %s -> %d\n", p->pid, syscallnames[num], (int)p->trapframe->a0);
   } else {
     printf("%d %s: unknown sys call %d\n",
             p->pid, p->name, num);
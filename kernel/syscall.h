@@ -31,3 +31,13 @@
 #define SYS_munmap    28
 #define SYS_connect   29
 #define SYS_pgaccess  30
+#define SYS_wsinfo    31
+#define SYS_spawn     32
+#define SYS_clone     33
+#define SYS_futex_wait 34
+#define SYS_futex_wake 35
+#define SYS_getprocinfo 36
+#define SYS_profile 37
+#define SYS_tracemask 38
+#define SYS_syscallstat 39
+#define SYS_perfinfo 40
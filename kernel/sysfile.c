@@ -76,6 +76,10 @@ sys_read(void)
   argint(2, &n);
   if(argfd(0, 0, &f) < 0)
     return -1;
+  // fault in the buffer now: fileread() may hold locks
+  // that a page fault would need.
+  if(n > 0 && vmprefault(myproc(), p, n, 1) < 0)
+    return -1;
   return fileread(f, p, n);
 }
 
@@ -90,6 +94,8 @@ sys_write(void)
   argint(2, &n);
   if(argfd(0, 0, &f) < 0)
     return -1;
+  if(n > 0 && vmprefault(myproc(), p, n, 0) < 0)
+    return -1;
 
   return filewrite(f, p, n);
 }
@@ -431,47 +437,93 @@ sys_chdir(void)
   return 0;
 }
 
-uint64
-sys_exec(void)
+// Pack the strings of the user argv[] at uargv end to end
+// into one buffer, after ARGHDR bytes that exec() uses to build
+// argv[]. Returns the buffer, of 2^*order pages, with the number
+// of strings in *argc and their length in *len; or 0.
+static char*
+fetchargs(uint64 uargv, int *argc, int *len, int *order)
 {
-  char path[MAXPATH], *argv[MAXARG];
-  int i;
-  uint64 uargv, uarg;
+  char *args, *nargs;
+  int n;
+  uint64 uarg;
 
-  argaddr(1, &uargv);
-  if(argstr(0, path, MAXPATH) < 0) {
-    return -1;
-  }
-  memset(argv, 0, sizeof(argv));
-  for(i=0;; i++){
-    if(i >= NELEM(argv)){
-      goto bad;
-    }
-    if(fetchaddr(uargv+sizeof(uint64)*i, (uint64*)&uarg) < 0){
+  // Start with a page and double it when a string does not fit.
+  *order = 0;
+  if((args = kalloc_order(*order)) == 0)
+    return 0;
+  *len = ARGHDR;
+  for(*argc = 0;; (*argc)++){
+    if(fetchaddr(uargv+sizeof(uint64)*(*argc), (uint64*)&uarg) < 0)
       goto bad;
-    }
-    if(uarg == 0){
-      argv[i] = 0;
+    if(uarg == 0)
       break;
-    }
-    argv[i] = kalloc();
-    if(argv[i] == 0)
-      goto bad;
-    if(fetchstr(uarg, argv[i], PGSIZE) < 0)
+    if(*argc == MAXARG)
       goto bad;
+    while((n = fetchstr(uarg, args+*len, (PGSIZE<<*order) - *len)) < 0){
+      // a bad address fails at once; a string that is too
+      // long gets a bigger buffer.
+      if(n == -1 || *order == MAXARGORDER || (nargs = kalloc_order(*order+1)) == 0)
+        goto bad;
+      memmove(nargs, args, *len);
+      kfree_order(args, *order);
+      args = nargs;
+      (*order)++;
+    }
+    *len += n + 1;
   }
+  *len -= ARGHDR;
+  return args;
 
-  int ret = exec(path, argv);
+ bad:
+  kfree_order(args, *order);
+  return 0;
+}
 
-  for(i = 0; i < NELEM(argv) && argv[i] != 0; i++)
-    kfree(argv[i]);
+uint64
+sys_exec(void)
+{
+  char path[MAXPATH], *args;
+  int argc, len, order, ret;
+  uint64 uargv;
 
+  argaddr(1, &uargv);
+  if(argstr(0, path, MAXPATH) < 0) {
+    return -1;
+  }
+  if((args = fetchargs(uargv, &argc, &len, &order)) == 0)
+    return -1;
+  ret = exec(path, args, argc, len);
+  kfree_order(args, order);
   return ret;
+}
 
- bad:
-  for(i = 0; i < NELEM(argv) && argv[i] != 0; i++)
-    kfree(argv[i]);
-  return -1;
+// spawn(path, argv, fds): start path in a new process; fds
+// names the descriptors that become its 0, 1 and 2, or is 0 to
+// pass on the caller's own.
+uint64
+sys_spawn(void)
+{
+  char path[MAXPATH], *args;
+  int argc, len, order, ret, i;
+  int fds[3] = { 0, 1, 2 };
+  uint64 uargv, ufds;
+  struct proc *p = myproc();
+
+  argaddr(1, &uargv);
+  argaddr(2, &ufds);
+  if(argstr(0, path, MAXPATH) < 0)
+    return -1;
+  if(ufds && copyin(p->pagetable, (char*)fds, ufds, sizeof(fds)) < 0)
+    return -1;
+  for(i = 0; i < 3; i++)
+    if(fds[i] >= NOFILE)
+      return -1;
+  if((args = fetchargs(uargv, &argc, &len, &order)) == 0)
+    return -1;
+  ret = spawn(path, args, argc, len, fds);
+  kfree_order(args, order);
+  return ret;
 }
 
 uint64
@@ -503,3 +555,56 @@ sys_pipe(void)
   }
   return 0;
 }
+
+uint64
+sys_mmap(void)
+{
+  uint64 addr, len;
+  int prot, flags, off, perm = 0;
+  struct file *f;
+  struct proc *p = myproc();
+
+  argaddr(0, &addr);
+  argaddr(1, &len);
+  argint(2, &prot);
+  argint(3, &flags);
+  argint(5, &off);
+  if(argfd(4, 0, &f) < 0)
+    return -1;
+  if(addr != 0 || off < 0 || off % PGSIZE != 0)
+    return -1;
+  if(flags != MAP_SHARED && flags != MAP_PRIVATE)
+    return -1;
+  if(f->type != FD_INODE || !f->readable)
+    return -1;
+  if((prot & PROT_WRITE) && flags == MAP_SHARED && !f->writable)
+    return -1;
+
+  if(prot & PROT_READ)
+    perm |= PTE_R;
+  if(prot & PROT_WRITE)
+    perm |= PTE_R | PTE_W;
+  if(prot & PROT_EXEC)
+    perm |= PTE_X;
+  if(perm == 0)
+    return -1;
+  vmlock(p);
+  addr = vmmap(p->mm, len, perm, flags, f->ip, off);
+  vmunlock(p);
+  return addr;
+}
+
+uint64
+sys_munmap(void)
+{
+  uint64 addr, len;
+  struct proc *p = myproc();
+  int r;
+
+  argaddr(0, &addr);
+  argaddr(1, &len);
+  vmlock(p);
+  r = vmunmap(p->mm, addr, len);
+  vmunlock(p);
+  return r;
+}
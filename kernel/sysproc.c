@@ -5,6 +5,8 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "wsinfo.h"
+#include "perfinfo.h"
 
 uint64
 sys_exit(void)
@@ -27,6 +29,39 @@ sys_fork(void)
   return fork();
 }
 
+uint64
+sys_futex_wait(void)
+{
+  uint64 addr;
+  int val;
+
+  argaddr(0, &addr);
+  argint(1, &val);
+  return futexwait(addr, val);
+}
+
+uint64
+sys_futex_wake(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return futexwake(addr, n);
+}
+
+uint64
+sys_clone(void)
+{
+  uint64 fn, arg, stack;
+
+  argaddr(0, &fn);
+  argaddr(1, &arg);
+  argaddr(2, &stack);
+  return clone(fn, arg, stack);
+}
+
 uint64
 sys_wait(void)
 {
@@ -38,14 +73,10 @@ sys_wait(void)
 uint64
 sys_sbrk(void)
 {
-  uint64 addr;
   int n;
 
   argint(0, &n);
-  addr = myproc()->sz;
-  if(growproc(n) < 0)
-    return -1;
-  return addr;
+  return growproc(n);
 }
 
 uint64
@@ -71,14 +102,125 @@ sys_sleep(void)
 
 
 #ifdef LAB_PGTBL
-int
+// Report which of the len pages from the one holding base
+// have been accessed since the last call, as a bitmap at mask.
+uint64
 sys_pgaccess(void)
 {
-  // lab pgtbl: your code here.
+  struct proc *p = myproc();
+  uint64 base, mask, bits[8];
+  int len, n;
+
+  argaddr(0, &base);
+  argint(1, &len);
+  argaddr(2, &mask);
+  if(len < 0 || base >= MAXVA || len > (MAXVA - PGROUNDDOWN(base)) / PGSIZE)
+    return -1;
+  // a bitmap of 512 pages at a time.
+  for(; len > 0; len -= n, base += (uint64)n*PGSIZE, mask += n/8){
+    n = len < 512 ? len : 512;
+    memset(bits, 0, sizeof(bits));
+    uvmaccess(p->pagetable, base, n, bits);
+    if(copyout(p->pagetable, mask, (char*)bits, (n+7)/8) < 0)
+      return -1;
+  }
   return 0;
 }
 #endif
 
+// Copy the working set of process pid (0 for the caller) as
+// last sampled to the struct wsinfo at addr.
+uint64
+sys_wsinfo(void)
+{
+  struct wsinfo ws;
+  uint64 addr;
+  int pid;
+
+  argint(0, &pid);
+  argaddr(1, &addr);
+  if(wsget(pid, &ws) < 0)
+    return -1;
+  if(copyout(myproc()->pagetable, addr, (char*)&ws, sizeof(ws)) < 0)
+    return -1;
+  return 0;
+}
+
+// Copy a struct procinfo for each process, up to n, to addr.
+uint64
+sys_getprocinfo(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return getprocinfo(addr, n);
+}
+
+// Start profiling at n samples per clock tick, or stop if n is 0.
+uint64
+sys_profile(void)
+{
+  int n;
+
+  argint(0, &n);
+  return profile(n);
+}
+
+// Trace the event categories whose bits are set in the
+// argument; returns the old mask.
+uint64
+sys_tracemask(void)
+{
+  int mask;
+
+  argint(0, &mask);
+  return settracemask(mask);
+}
+
+// Print the system calls whose bits are set in the argument,
+// as the caller and its future children make them.
+uint64
+sys_trace(void)
+{
+  uint64 mask;
+
+  argaddr(0, &mask);
+  myproc()->sctrace = mask;
+  return 0;
+}
+
+// Copy system call counts and latency histograms to addr.
+uint64
+sys_syscallstat(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return syscallstat(addr, n);
+}
+
+// Copy the performance counts of process pid (0 for the
+// caller) to the struct perfinfo at addr.
+uint64
+sys_perfinfo(void)
+{
+  struct perfinfo pi;
+  uint64 addr;
+  int pid;
+
+  argint(0, &pid);
+  argaddr(1, &addr);
+  if(perfget(pid, &pi) < 0)
+    return -1;
+  if(copyout(myproc()->pagetable, addr, (char*)&pi, sizeof(pi)) < 0)
+    return -1;
+  return 0;
+}
+
 uint64
 sys_kill(void)
 {
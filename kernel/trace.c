@@ -0,0 +1,132 @@
+//
+// Kernel event tracing. TRACE() (see trace.h) appends an event
+// to the ring of the CPU it runs on. Only that CPU adds to a
+// ring, with interrupts off, so adding takes no lock; reading
+// the trace device takes events out of all the rings, and
+// readers are serialized by trace.lock. A full ring drops new
+// events and counts them.
+//
+// tracemask(mask) turns on the categories whose bits are set
+// in mask.
+//
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "fs.h"
+#include "file.h"
+#include "trace.h"
+#include "defs.h"
+
+uint tracemask;              // categories on
+
+struct {
+  struct traceevent ev[NTRACEEVENT];
+  uint head;                 // next to read; advanced by readers
+  uint tail;                 // next to write; advanced by this CPU
+  uint dropped;
+} rings[NCPU];
+
+struct spinlock tracelock;
+
+// Record an event; called through TRACE().
+void
+trace(int id, uint64 arg0, uint64 arg1)
+{
+  struct traceevent *e;
+  struct proc *p;
+  int c;
+
+  push_off();
+  c = cpuid();
+  if(rings[c].tail - rings[c].head >= NTRACEEVENT){
+    rings[c].dropped++;
+    pop_off();
+    return;
+  }
+  e = &rings[c].ev[rings[c].tail % NTRACEEVENT];
+  e->time = r_time();
+  e->arg0 = arg0;
+  e->arg1 = arg1;
+  p = mycpu()->proc;
+  e->pid = p ? p->pid : 0;
+  e->cpu = c;
+  e->id = id;
+  // a reader must see the event before the new tail.
+  __sync_synchronize();
+  rings[c].tail++;
+  pop_off();
+}
+
+// Turn on the categories in mask, and off the others.
+// Returns the old mask.
+int
+settracemask(int mask)
+{
+  int old = tracemask;
+
+  tracemask = mask & ((1 << NTRACECAT) - 1);
+  return old;
+}
+
+static int
+tracewrite(int user_src, uint64 src, int n)
+{
+  return -1;
+}
+
+// Take whole events out of the rings, up to n bytes, one
+// CPU's after another. Returns 0 when there are none left.
+static int
+traceread(int user_dst, uint64 dst, int n)
+{
+  struct traceevent batch[8];
+  int c, m, tot;
+  uint tail;
+
+  tot = 0;
+  for(c = 0; c < NCPU; c++){
+    for(;;){
+      // copy out without the lock, since that may sleep.
+      acquire(&tracelock);
+      tail = rings[c].tail;
+      __sync_synchronize();
+      for(m = 0; m < NELEM(batch) && rings[c].head + m != tail &&
+            tot + (m+1)*sizeof(batch[0]) <= n; m++)
+        batch[m] = rings[c].ev[(rings[c].head + m) % NTRACEEVENT];
+      // the CPU may reuse the slots once head moves.
+      __sync_synchronize();
+      rings[c].head += m;
+      release(&tracelock);
+      if(m == 0)
+        break;
+      if(either_copyout(user_dst, dst + tot, batch, m*sizeof(batch[0])) < 0)
+        return -1;
+      tot += m*sizeof(batch[0]);
+    }
+  }
+  return tot;
+}
+
+// Format trace counters for the statistics device.
+int
+tracestats(char *buf, int sz)
+{
+  int c, dropped;
+
+  dropped = 0;
+  for(c = 0; c < NCPU; c++)
+    dropped += rings[c].dropped;
+  return snprintf(buf, sz, "trace: mask %x dropped %d\n", tracemask, dropped);
+}
+
+void
+traceinit(void)
+{
+  initlock(&tracelock, "trace");
+  devsw[TRACEDEV].read = traceread;
+  devsw[TRACEDEV].write = tracewrite;
+}
@@ -0,0 +1,42 @@
+// Tracepoints. An event id is its category number times 256
+// plus its number within the category; tracing is turned on
+// by category (see tracemask()).
+
+#define TC_BIO     0
+#define TC_DISK    1
+#define TC_KALLOC  2
+#define TC_SCHED   3
+#define TC_LOG     4
+#define TC_SLEEP   5
+#define NTRACECAT  6
+
+                                        // arg0, arg1:
+#define TE_BREADMISS   (TC_BIO<<8 | 0)    // dev, blockno
+#define TE_BWRITE      (TC_BIO<<8 | 1)    // dev, blockno
+#define TE_DISKSUBMIT  (TC_DISK<<8 | 0)   // blockno, write
+#define TE_DISKDONE    (TC_DISK<<8 | 1)   // blockno
+#define TE_KALLOCFAIL  (TC_KALLOC<<8 | 0)  // order
+#define TE_SWITCHIN    (TC_SCHED<<8 | 0)  // pid
+#define TE_SWITCHOUT   (TC_SCHED<<8 | 1)  // pid, state
+#define TE_OPWAIT      (TC_LOG<<8 | 0)    // outstanding, committing
+#define TE_OPBEGIN     (TC_LOG<<8 | 1)    // outstanding
+#define TE_OPEND       (TC_LOG<<8 | 2)    // outstanding
+#define TE_COMMIT      (TC_LOG<<8 | 3)    // blocks
+#define TE_COMMITDONE  (TC_LOG<<8 | 4)
+#define TE_SLEEP       (TC_SLEEP<<8 | 0)  // chan
+#define TE_WAKEUP      (TC_SLEEP<<8 | 1)  // pid, chan
+
+// An event, as read from the trace device.
+struct traceevent {
+  uint64 time;     // timer cycles since boot
+  uint64 arg0;
+  uint64 arg1;
+  int pid;         // process running then, 0 if none
+  short cpu;
+  short id;
+};
+
+// In the kernel: record event ev if its category is on.
+// Costs a load and a test when it is off.
+#define TRACE(ev, a0, a1) \
+  do { if(tracemask & (1 << ((ev) >> 8))) trace((ev), (uint64)(a0), (uint64)(a1)); } while(0)
@@ -46,12 +46,22 @@ usertrap(void)
   w_stvec((uint64)kernelvec);
 
   struct proc *p = myproc();
+  struct cpu *c = mycpu();
+  uint64 now = r_time();
+
+  // account for the time in user space since usertrapret().
+  p->utime += now - p->userstart;
+  c->utime += now - p->userstart;
+  p->uhpm.cycle += r_cycle() - p->uhpmstart.cycle;
+  p->uhpm.instret += r_instret() - p->uhpmstart.instret;
   
   // save user program counter.
   p->trapframe->epc = r_sepc();
   
   if(r_scause() == 8){
     // system call
+    p->nsyscall++;
+    c->nsyscall++;
 
     if(killed(p))
       exit(-1);
@@ -67,6 +77,21 @@ usertrap(void)
     syscall();
   } else if((which_dev = devintr()) != 0){
     // ok
+  } else if(r_scause() == 12 || r_scause() == 13 || r_scause() == 15){
+    // page fault, perhaps on a demand-paged page.
+    uint64 scause = r_scause(), va = r_stval();
+    int r;
+    p->nfault++;
+    c->nfault++;
+    intr_on();
+    p->swapok = 1;
+    r = vmfault(p, va, scause == 15);
+    p->swapok = 0;
+    if(r < 0){
+      printf("usertrap(): unexpected scause %p pid=%d\n", scause, p->pid);
+      printf("            sepc=%p stval=%p\n", p->trapframe->epc, va);
+      setkilled(p);
+    }
   } else {
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
     printf("            sepc=%p stval=%p\n", r_sepc(), r_stval());
@@ -77,8 +102,13 @@ usertrap(void)
     exit(-1);
 
   // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
+  // until p runs again, swap.c may take its pages.
+  if(which_dev == 2){
+    wssample(p);
+    p->swapok = 1;
     yield();
+    p->swapok = 0;
+  }
 
   usertrapret();
 }
@@ -96,6 +126,17 @@ usertrapret(void)
   // we're back in user space, where usertrap() is correct.
   intr_off();
 
+  // userret flushes the TLB as it switches to the user page
+  // table (see tlbsync()).
+  p->tlbgen++;
+
+#ifdef LAB_PGTBL
+  // refresh what the process can read at USYSCALL.
+  p->usyscall->ticks = ticks;
+  p->usyscall->cpu = cpuid();
+  p->usyscall->runtime = p->runtime + (r_time() - p->runstart);
+#endif
+
   // send syscalls, interrupts, and exceptions to uservec in trampoline.S
   uint64 trampoline_uservec = TRAMPOLINE + (uservec - trampoline);
   w_stvec(trampoline_uservec);
@@ -126,6 +167,9 @@ usertrapret(void)
   // switches to the user page table, restores user registers,
   // and switches to user mode with sret.
   uint64 trampoline_userret = TRAMPOLINE + (userret - trampoline);
+  p->userstart = r_time();
+  p->uhpmstart.cycle = r_cycle();
+  p->uhpmstart.instret = r_instret();
   ((void (*)(uint64))trampoline_userret)(satp);
 }
 
@@ -167,6 +211,9 @@ clockintr()
   ticks++;
   wakeup(&ticks);
   release(&tickslock);
+
+  // send on what printf()s holding locks have logged.
+  klogdrain();
 }
 
 // check if it's an external interrupt or software interrupt,
@@ -205,6 +252,12 @@ devintr()
     // software interrupt from a machine-mode timer interrupt,
     // forwarded by timervec in kernelvec.S.
 
+    // while profiling, not every timer interrupt is a tick.
+    if(profrate && !profintr()){
+      w_sip(r_sip() & ~2);
+      return 1;
+    }
+
     if(cpuid() == 0){
       clockintr();
     }
@@ -15,6 +15,7 @@
 #include "fs.h"
 #include "buf.h"
 #include "virtio.h"
+#include "trace.h"
 
 // the address of virtio mmio register r.
 #define R(r) ((volatile uint32 *)(VIRTIO0 + (r)))
@@ -275,6 +276,7 @@ virtio_disk_rw(struct buf *b, int write)
 
   // tell the device another avail ring entry is available.
   disk.avail->idx += 1; // not % NUM ...
+  TRACE(TE_DISKSUBMIT, b->blockno, write);
 
   __sync_synchronize();
 
@@ -317,6 +319,7 @@ virtio_disk_intr()
       panic("virtio_disk_intr status");
 
     struct buf *b = disk.info[id].b;
+    TRACE(TE_DISKDONE, b->blockno, 0);
     b->disk = 0;   // disk is done with buf
     wakeup(b);
 
@@ -3,6 +3,7 @@
 #include "memlayout.h"
 #include "elf.h"
 #include "riscv.h"
+#include "vm.h"
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
@@ -17,6 +18,8 @@ extern char etext[];  // kernel.ld sets this to end of kernel code.
 
 extern char trampoline[]; // trampoline.S
 
+static pte_t *walklevel(pagetable_t, uint64, int, int, int *);
+
 // Make a direct-map page table for the kernel.
 pagetable_t
 kvmmake(void)
@@ -41,10 +44,6 @@ kvmmake(void)
   // map kernel data and the physical RAM we'll make use of.
   kvmmap(kpgtbl, (uint64)etext, (uint64)etext, PHYSTOP-(uint64)etext, PTE_R | PTE_W);
 
-  // map the trampoline for trap entry/exit to
-  // the highest virtual address in the kernel.
-  kvmmap(kpgtbl, TRAMPOLINE, (uint64)trampoline, PGSIZE, PTE_R | PTE_X);
-  
   return kpgtbl;
 }
 
@@ -53,15 +52,30 @@ void
 kvminit(void)
 {
   kernel_pagetable = kvmmake();
+
+  // map the trampoline for trap entry/exit to
+  // the highest virtual address in the kernel.
+  kvmmap(kernel_pagetable, TRAMPOLINE, (uint64)trampoline, PGSIZE, PTE_R | PTE_X);
+
   // allocate and map a kernel stack for each process.
   proc_mapstacks(kernel_pagetable);
+
+  // user_kvmmake() shares the top 1 GB, which holds only the
+  // trampoline and the stacks.
+  if(PX(2, KSTACK(NPROC-1)) != PX(2, TRAMPOLINE))
+    panic("kvminit: kernel stacks extend beyond the top 1 GB");
 }
 
+// Make a per-process kernel page table. The trampoline and the
+// kernel stacks are mapped by sharing the global table's page
+// table for the top 1 GB, so this takes the same time however
+// large NPROC is; proc_free_kernel_pagetable() leaves that
+// shared part alone.
 pagetable_t
 user_kvmmake(void)
 { 
   pagetable_t kpgtbl = kvmmake();
-  proc_setstacks(kernel_pagetable, kpgtbl);
+  kpgtbl[PX(2, TRAMPOLINE)] = kernel_pagetable[PX(2, TRAMPOLINE)];
   return kpgtbl;
 }
 
@@ -94,6 +108,8 @@ switch_kernel_pagetable(pagetable_t kernel_pagetable)
 // Return the address of the PTE in page table pagetable
 // that corresponds to virtual address va.  If alloc!=0,
 // create any required page-table pages.
+// If va lies inside a 2 MB megapage, return the level-1
+// PTE that maps the whole megapage.
 //
 // The risc-v Sv39 scheme has three levels of page-table
 // pages. A page-table page contains 512 64-bit PTEs.
@@ -106,12 +122,27 @@ switch_kernel_pagetable(pagetable_t kernel_pagetable)
 pte_t *
 walk(pagetable_t pagetable, uint64 va, int alloc)
 {
+  int level;
+
+  return walklevel(pagetable, va, alloc, 0, &level);
+}
+
+// Descend from the root towards the level-stop PTE for va,
+// setting *level to the level of the PTE returned. Stops early,
+// at a higher level, if it finds a leaf PTE there (a megapage).
+static pte_t *
+walklevel(pagetable_t pagetable, uint64 va, int alloc, int stop, int *level)
+{
+  pte_t *pte;
+
   if(va >= MAXVA)
     panic("walk");
 
-  for(int level = 2; level > 0; level--) {
-    pte_t *pte = &pagetable[PX(level, va)];
+  for(*level = 2; *level > stop; (*level)--) {
+    pte = &pagetable[PX(*level, va)];
     if(*pte & PTE_V) {
+      if(PTE_LEAF(*pte))
+        return pte;
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
       if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
@@ -120,7 +151,110 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
-  return &pagetable[PX(0, va)];
+  return &pagetable[PX(stop, va)];
+}
+
+// Start a walk over the PTEs for [va, end). va need not be
+// page-aligned. flags is a mask of VMWALK_ALLOC, to create
+// missing page-table pages as the walk reaches them, and
+// VMWALK_MEGA, to be offered empty 2 MB slots (see vmwalk_next).
+void
+vmwalk_init(struct vmwalk *w, pagetable_t pagetable, uint64 va, uint64 end, int flags)
+{
+  w->pagetable = pagetable;
+  w->va = PGROUNDDOWN(va);
+  w->end = end;
+  w->pte = 0;
+  w->level = 0;
+  w->left = 0;
+  w->flags = flags;
+  w->started = 0;
+}
+
+// Advance w to the next page of its range, setting w->va,
+// w->pte and w->level. Returns 0 once the range is exhausted.
+//
+// w->level is 1 when w->pte is a level-1 PTE covering the whole
+// 2 MB around w->va: either an existing megapage, or (with
+// VMWALK_MEGA) an empty slot for an aligned 2 MB piece of the
+// range, which the caller may fill with a megapage or give up on
+// with vmwalk_descend(). The next step then starts at the
+// following 2 MB boundary.
+//
+// w->pte is 0 if the leaf page-table page is missing (or could
+// not be allocated); the walk still steps through the pages it
+// would have covered, so callers see every va in order.
+int
+vmwalk_next(struct vmwalk *w)
+{
+  pte_t *pte;
+  int level;
+
+  if(w->started){
+    if(w->level == 1)
+      w->va = MEGAPGROUNDDOWN(w->va) + MEGAPGSIZE;
+    else
+      w->va += PGSIZE;
+  }
+  w->started = 1;
+  if(w->va >= w->end)
+    return 0;
+
+  if(w->level == 0 && w->left > 0){
+    // still inside the same leaf page-table page.
+    w->left--;
+    if(w->pte)
+      w->pte++;
+    return 1;
+  }
+
+  pte = walklevel(w->pagetable, w->va, w->flags & VMWALK_ALLOC, 1, &level);
+  if(pte == 0){
+    w->pte = 0;
+    w->level = 0;
+    w->left = PXMASK - PX(0, w->va);
+    return 1;
+  }
+  if(level != 1)
+    panic("vmwalk: gigapage");
+
+  w->pte = pte;
+  w->level = 1;
+  if(*pte & PTE_V){
+    if(PTE_LEAF(*pte))
+      return 1;
+  } else if((w->flags & VMWALK_MEGA) && w->va % MEGAPGSIZE == 0 &&
+            w->end - w->va >= MEGAPGSIZE){
+    return 1;
+  }
+  vmwalk_descend(w);
+  return 1;
+}
+
+// Move w from the level-1 PTE for w->va down to the 4 KB PTE
+// for w->va, creating the leaf page-table page if w was started
+// with VMWALK_ALLOC. Returns 0 on success, or -1 (with w->pte
+// set to 0) if there is no leaf page-table page.
+int
+vmwalk_descend(struct vmwalk *w)
+{
+  pagetable_t pagetable;
+  pte_t *pte = w->pte;
+
+  w->level = 0;
+  w->left = PXMASK - PX(0, w->va);
+  if((*pte & PTE_V) == 0){
+    if((w->flags & VMWALK_ALLOC) == 0 || (pagetable = (pagetable_t)kalloc()) == 0){
+      w->pte = 0;
+      return -1;
+    }
+    memset(pagetable, 0, PGSIZE);
+    *pte = PA2PTE(pagetable) | PTE_V;
+  } else if(PTE_LEAF(*pte)){
+    panic("vmwalk_descend: megapage");
+  }
+  w->pte = &((pagetable_t)PTE2PA(*pte))[PX(0, w->va)];
+  return 0;
 }
 
 // void
@@ -139,11 +273,12 @@ walkaddr(pagetable_t pagetable, uint64 va)
 {
   pte_t *pte;
   uint64 pa;
+  int level;
 
   if(va >= MAXVA)
     return 0;
 
-  pte = walk(pagetable, va, 0);
+  pte = walklevel(pagetable, va, 0, 0, &level);
   if(pte == 0)
     return 0;
   if((*pte & PTE_V) == 0)
@@ -151,17 +286,34 @@ walkaddr(pagetable_t pagetable, uint64 va)
   if((*pte & PTE_U) == 0)
     return 0;
   pa = PTE2PA(*pte);
+  if(level == 1)
+    pa += PGROUNDDOWN(va % MEGAPGSIZE);
   return pa;
 }
 
 // add a mapping to the kernel page table.
 // only used when booting.
 // does not flush TLB or enable paging.
+// each 2 MB-aligned stretch of the range is mapped with
+// a single megapage PTE.
 void
 kvmmap(pagetable_t kpgtbl, uint64 va, uint64 pa, uint64 sz, int perm)
 {
-  if(mappages(kpgtbl, va, sz, pa, perm) != 0)
-    panic("kvmmap");
+  struct vmwalk w;
+  uint64 a;
+
+  if(sz == 0)
+    panic("kvmmap: size");
+
+  vmwalk_init(&w, kpgtbl, va, PGROUNDDOWN(va + sz - 1) + PGSIZE, VMWALK_ALLOC|VMWALK_MEGA);
+  while(vmwalk_next(&w)){
+    a = pa + (w.va - PGROUNDDOWN(va));
+    if(w.level == 1 && (a % MEGAPGSIZE) != 0 && vmwalk_descend(&w) < 0)
+      panic("kvmmap");
+    if(w.pte == 0 || (*w.pte & PTE_V))
+      panic("kvmmap");
+    *w.pte = PA2PTE(a) | perm | PTE_V;
+  }
 }
 
 // Create PTEs for virtual addresses starting at va that refer to
@@ -171,26 +323,18 @@ kvmmap(pagetable_t kpgtbl, uint64 va, uint64 pa, uint64 sz, int perm)
 int
 mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
 {
-  uint64 a, last;
-  pte_t *pte;
+  struct vmwalk w;
 
   if(size == 0)
     panic("mappages: size");
   
-  a = PGROUNDDOWN(va);
-  last = PGROUNDDOWN(va + size - 1);
-  for(;;){
-    if((pte = walk(pagetable, a, 1)) == 0) {
+  vmwalk_init(&w, pagetable, va, PGROUNDDOWN(va + size - 1) + PGSIZE, VMWALK_ALLOC);
+  for(; vmwalk_next(&w); pa += PGSIZE){
+    if(w.pte == 0)
       return -1;
-    }
-      
-    if(*pte & PTE_V)
+    if(*w.pte & PTE_V)
       panic("mappages: remap");
-    *pte = PA2PTE(pa) | perm | PTE_V;
-    if(a == last)
-      break;
-    a += PGSIZE;
-    pa += PGSIZE;
+    *w.pte = PA2PTE(pa) | perm | PTE_V;
   }
   return 0;
 }
@@ -201,29 +345,123 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
 void
 uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 {
-  uint64 a;
-  pte_t *pte;
+  struct vmwalk w;
 
   if((va % PGSIZE) != 0)
     panic("uvmunmap: not aligned");
 
-  for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
-    if((pte = walk(pagetable, a, 0)) == 0) {
-      panic("uvmunmap: walk");
+  for(vmwalk_init(&w, pagetable, va, va + npages*PGSIZE, 0); vmwalk_next(&w); ){
+    if(w.pte && (*w.pte & PTE_S)){
+      if(do_free)
+        swapfree(*w.pte);
+      *w.pte = 0;
+      continue;
     }
-      
-    if((*pte & PTE_V) == 0)
-      panic("uvmunmap: not mapped");
-    if(PTE_FLAGS(*pte) == PTE_V)
+    // demand-paged pages may never have been mapped.
+    if(w.pte == 0 || (*w.pte & PTE_V) == 0)
+      continue;
+    if(PTE_FLAGS(*w.pte) == PTE_V)
       panic("uvmunmap: not a leaf");
+    if(w.level == 1){
+      // callers split a megapage before unmapping part of it.
+      if(w.va % MEGAPGSIZE != 0 || w.end - w.va < MEGAPGSIZE)
+        panic("uvmunmap: partial megapage");
+      if(do_free)
+        kfree_order((void*)PTE2PA(*w.pte), MEGAPGORDER);
+      *w.pte = 0;
+      continue;
+    }
     if(do_free){
-      uint64 pa = PTE2PA(*pte);
+      uint64 pa = PTE2PA(*w.pte);
       kfree((void*)pa);
     }
-    *pte = 0;
+    *w.pte = 0;
+  }
+}
+
+#define NBATCH 64
+
+// Unmap and free the pages of [va, end), a page-aligned range
+// of the current process's memory, from its user page table
+// and its per-process kernel page table kpagetable. Other
+// threads may still be using the pages through their TLBs, so
+// they are unmapped a batch at a time, and each batch is freed
+// only after tlbsync().
+void
+uvmunmapsync(pagetable_t pagetable, pagetable_t kpagetable, uint64 va, uint64 end)
+{
+  struct vmwalk w;
+  uint64 pa[NBATCH], stop;
+  int i, n;
+
+  while(va < end){
+    // pa[i] has its low bit set for a megapage.
+    n = 0;
+    stop = end;
+    for(vmwalk_init(&w, pagetable, va, end, 0); vmwalk_next(&w); ){
+      if(w.pte && (*w.pte & PTE_S)){
+        swapfree(*w.pte);
+        *w.pte = 0;
+        continue;
+      }
+      if(w.pte == 0 || (*w.pte & PTE_V) == 0)
+        continue;
+      if(PTE_FLAGS(*w.pte) == PTE_V)
+        panic("uvmunmapsync: not a leaf");
+      if(w.level == 1 && (w.va % MEGAPGSIZE != 0 || w.end - w.va < MEGAPGSIZE))
+        panic("uvmunmapsync: partial megapage");
+      pa[n++] = PTE2PA(*w.pte) | (w.level == 1);
+      *w.pte = 0;
+      if(n == NBATCH){
+        stop = w.va + (w.level == 1 ? MEGAPGSIZE : PGSIZE);
+        break;
+      }
+    }
+    clear_pte(kpagetable, va, stop);
+    tlbsync(myproc());
+    for(i = 0; i < n; i++){
+      if(pa[i] & 1)
+        kfree_order((void*)(pa[i] & ~1L), MEGAPGORDER);
+      else
+        kfree((void*)pa[i]);
+    }
+    va = stop;
   }
 }
 
+// If va lies strictly inside a 2 MB megapage mapping, replace
+// the megapage PTE with a page-table page of 512 4 KB PTEs for
+// the same memory, so that part of it can be unmapped. If own
+// is set, pagetable holds the memory's reference, and the
+// allocator's block is split too, so that its pages can be
+// freed one at a time; a mirror such as the per-process kernel
+// page table passes 0.
+// Returns 0 on success, -1 if out of memory.
+int
+uvmsplit(pagetable_t pagetable, uint64 va, int own)
+{
+  pagetable_t leaf;
+  pte_t *pte;
+  uint64 pa;
+  int i, level;
+
+  if(va % MEGAPGSIZE == 0 || va >= MAXVA)
+    return 0;
+  pte = walklevel(pagetable, va, 0, 0, &level);
+  if(pte == 0 || level != 1 || (*pte & PTE_V) == 0)
+    return 0;
+
+  if((leaf = (pagetable_t)kalloc()) == 0)
+    return -1;
+  pa = PTE2PA(*pte);
+  for(i = 0; i < 512; i++)
+    leaf[i] = PA2PTE(pa + i*PGSIZE) | PTE_FLAGS(*pte);
+  *pte = PA2PTE(leaf) | PTE_V;
+  if(own)
+    ksplit((void*)pa, MEGAPGORDER);
+  return 0;
+}
+
 // create an empty user page table.
 // returns 0 if out of memory.
 pagetable_t
@@ -255,28 +493,36 @@ uvmfirst(pagetable_t pagetable, uchar *src, uint sz)
 
 // Allocate PTEs and physical memory to grow process from oldsz to
 // newsz, which need not be page aligned.  Returns new size or 0 on error.
+// Every aligned 2 MB piece of the new region is backed by a
+// megapage if one is free.
 uint64
 uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
 {
   char *mem;
-  uint64 a;
+  struct vmwalk w;
 
   if(newsz < oldsz)
     return oldsz;
 
   oldsz = PGROUNDUP(oldsz);
-  for(a = oldsz; a < newsz; a += PGSIZE){
-    mem = kalloc();
-    if(mem == 0){
-      uvmdealloc(pagetable, a, oldsz);
-      return 0;
+  vmwalk_init(&w, pagetable, oldsz, newsz, VMWALK_ALLOC|VMWALK_MEGA);
+  while(vmwalk_next(&w)){
+    if(w.pte && (*w.pte & PTE_V))
+      panic("uvmalloc: remap");
+    if(w.level == 1){
+      if((mem = kalloc_order(MEGAPGORDER)) != 0){
+        memset(mem, 0, MEGAPGSIZE);
+        *w.pte = PA2PTE(mem) | PTE_R | PTE_U | xperm | PTE_V;
+        continue;
+      }
+      vmwalk_descend(&w);
     }
-    memset(mem, 0, PGSIZE);
-    if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_R|PTE_U|xperm) != 0){
-      kfree(mem);
-      uvmdealloc(pagetable, a, oldsz);
+    if(w.pte == 0 || (mem = kalloc()) == 0){
+      uvmdealloc(pagetable, w.va, oldsz);
       return 0;
     }
+    memset(mem, 0, PGSIZE);
+    *w.pte = PA2PTE(mem) | PTE_R | PTE_U | xperm | PTE_V;
   }
   return newsz;
 }
@@ -311,19 +557,18 @@ userkernel_unmap(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
 void
 clear_pte(pagetable_t pagetable, uint64 newsz, uint64 oldsz)
 {
-  int npages = (PGROUNDUP(oldsz) - PGROUNDUP(newsz)) / PGSIZE;
-  int aligned_start_va = PGROUNDUP(newsz);
-  uint64 a;
-  pte_t *pte;
+  struct vmwalk w;
 
-  for(a = aligned_start_va; a < aligned_start_va + npages*PGSIZE; a += PGSIZE){
-    if((pte = walk(pagetable, a, 0)) == 0)
+  for(vmwalk_init(&w, pagetable, PGROUNDUP(newsz), PGROUNDUP(oldsz), 0); vmwalk_next(&w); ){
+    if(w.pte == 0)
       continue;
-    if((*pte & PTE_V) == 0)
+    if((*w.pte & PTE_V) == 0)
       continue;
-    if(PTE_FLAGS(*pte) == PTE_V)
+    if(PTE_FLAGS(*w.pte) == PTE_V)
       continue;
-    *pte = 0;
+    if(w.level == 1 && (w.va % MEGAPGSIZE != 0 || w.end - w.va < MEGAPGSIZE))
+      panic("clear_pte: partial megapage");
+    *w.pte = 0;
   }
 }
 
@@ -380,36 +625,82 @@ uvmfree(pagetable_t pagetable, uint64 sz)
 // Given a parent process's page table, copy
 // its memory into a child's page table.
 // Copies both the page table and the
-// physical memory.
+// physical memory, except that read-only
+// pages are shared with the child.
 // returns 0 on success, -1 on failure.
 // frees any allocated pages on failure.
 int
 uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
 {
-  pte_t *pte;
-  uint64 pa, i;
+  struct vmwalk ow, nw;
+  uint64 pa;
   uint flags;
   char *mem;
+  int i;
+
+  // walk both page tables in step, so each side descends
+  // from the root once per leaf page-table page.
+  vmwalk_init(&nw, new, 0, sz, VMWALK_ALLOC|VMWALK_MEGA);
+  for(vmwalk_init(&ow, old, 0, sz, 0); vmwalk_next(&ow); ){
+    vmwalk_next(&nw);
+    if(ow.level == 1){
+      pa = PTE2PA(*ow.pte);
+      flags = PTE_FLAGS(*ow.pte);
+      if(nw.level != 1)
+        panic("uvmcopy: megapage");
+      if((mem = kalloc_order(MEGAPGORDER)) != 0){
+        memmove(mem, (char*)pa, MEGAPGSIZE);
+        *nw.pte = PA2PTE(mem) | flags;
+        continue;
+      }
+      // no free megapage: copy it as 512 small pages.
+      if(vmwalk_descend(&nw) < 0)
+        goto err;
+      for(i = 0; ; i++){
+        if((mem = kalloc()) == 0)
+          goto err;
+        memmove(mem, (char*)pa + i*PGSIZE, PGSIZE);
+        *nw.pte = PA2PTE(mem) | flags;
+        if(i == 511)
+          break;
+        vmwalk_next(&nw);
+      }
+      continue;
+    }
 
-  for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walk(old, i, 0)) == 0)
-      panic("uvmcopy: pte should exist");
-    if((*pte & PTE_V) == 0)
-      panic("uvmcopy: page not present");
-    pa = PTE2PA(*pte);
-    flags = PTE_FLAGS(*pte);
+    if(nw.level == 1)
+      vmwalk_descend(&nw);
+    if(ow.pte && (*ow.pte & PTE_S)){
+      // swapped out: the child shares the swap slot.
+      if(nw.pte == 0)
+        goto err;
+      swapdup(*ow.pte);
+      *nw.pte = *ow.pte;
+      continue;
+    }
+    if(ow.pte == 0 || (*ow.pte & PTE_V) == 0)
+      continue;  // not paged in yet; the child faults it in itself.
+    if(nw.pte == 0)
+      goto err;
+    pa = PTE2PA(*ow.pte);
+    flags = PTE_FLAGS(*ow.pte);
+    if(*nw.pte & PTE_V)
+      panic("uvmcopy: remap");
+    if((flags & PTE_W) == 0){
+      kdup((void*)pa);
+      *nw.pte = PA2PTE(pa) | flags;
+      continue;
+    }
     if((mem = kalloc()) == 0)
       goto err;
     memmove(mem, (char*)pa, PGSIZE);
-    if(mappages(new, i, PGSIZE, (uint64)mem, flags) != 0){
-      kfree(mem);
-      goto err;
-    }
+    *nw.pte = PA2PTE(mem) | flags;
   }
   return 0;
 
  err:
-  uvmunmap(new, 0, i / PGSIZE, 1);
+  // everything below nw.va has been mapped in new.
+  uvmunmap(new, 0, nw.va / PGSIZE, 1);
   return -1;
 }
 
@@ -426,6 +717,34 @@ uvmclear(pagetable_t pagetable, uint64 va)
   *pte &= ~PTE_U;
 }
 
+// Set bit i of bits[] for each page i, of the npages pages
+// from the one holding va, that has been accessed since the
+// last look, clearing its PTE_A bit (but setting PTE_SA, which
+// swap.c reads). All pages of a megapage count as accessed if
+// it was. bits[] must start out zero.
+void
+uvmaccess(pagetable_t pagetable, uint64 va, int npages, uint64 *bits)
+{
+  struct vmwalk w;
+  uint64 i, n, next;
+
+  va = PGROUNDDOWN(va);
+  for(vmwalk_init(&w, pagetable, va, va + (uint64)npages*PGSIZE, 0); vmwalk_next(&w); ){
+    if(w.pte == 0 || (*w.pte & (PTE_V|PTE_U|PTE_A)) != (PTE_V|PTE_U|PTE_A) ||
+       !PTE_LEAF(*w.pte))
+      continue;
+    *w.pte = (*w.pte & ~PTE_A) | PTE_SA;
+    n = 1;
+    if(w.level == 1){
+      next = MEGAPGROUNDDOWN(w.va) + MEGAPGSIZE;
+      n = ((next < w.end ? next : w.end) - w.va) / PGSIZE;
+    }
+    for(i = (w.va - va) / PGSIZE; n > 0; n--, i++)
+      bits[i / 64] |= 1L << (i % 64);
+  }
+  sfence_vma();   // so that the next access sets PTE_A again
+}
+
 // Copy from kernel to user.
 // Copy len bytes from src to virtual address dstva in a given page table.
 // Return 0 on success, -1 on error.
@@ -433,12 +752,27 @@ int
 copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 {
   uint64 n, va0, pa0;
+  pte_t *pte;
+  struct proc *p;
+  int level;
 
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0)
+    if(va0 >= MAXVA)
+      return -1;
+    // read-only pages may be shared with other processes;
+    // demand-paged and copy-on-write pages are faulted in.
+    pte = walklevel(pagetable, va0, 0, 0, &level);
+    if((pte == 0 || (*pte & (PTE_V|PTE_W)) != (PTE_V|PTE_W)) &&
+       (p = myproc()) != 0 && pagetable == p->pagetable &&
+       vmfault(p, va0, 1) == 0)
+      pte = walklevel(pagetable, va0, 0, 0, &level);
+    if(pte == 0 || (*pte & (PTE_V|PTE_U|PTE_W)) != (PTE_V|PTE_U|PTE_W))
       return -1;
+    *pte |= PTE_D;  // for write-back of MAP_SHARED pages
+    pa0 = PTE2PA(*pte);
+    if(level == 1)
+      pa0 += va0 % MEGAPGSIZE;
     n = PGSIZE - (dstva - va0);
     if(n > len)
       n = len;
@@ -463,7 +797,8 @@ copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 // Copy a null-terminated string from user to kernel.
 // Copy bytes to dst from virtual address srcva in a given page table,
 // until a '\0', or max.
-// Return 0 on success, -1 on error.
+// Return 0 on success, -1 on a bad address, -2 if there is no
+// '\0' within max bytes.
 int
 copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 {
@@ -501,23 +836,46 @@ vmprint(pagetable_t pagetable)
 }
 
 
+// Mirror the user mappings of p for [start, end) into the
+// process's kernel page table kpgtbl, without PTE_U, so the
+// kernel can dereference user addresses directly.
 // Returns 0 on success, -1 on failure.
 int
 copy_pagetable_to_kernel(pagetable_t kpgtbl, struct proc *p, uint64 start, uint64 end) 
 {
+  struct vmwalk uw, kw;
+  uint64 a;
+
   if (end >= PLIC)
     return -1;
-  for (uint64 va = PGROUNDDOWN(start); va < PGROUNDUP(end); va += PGSIZE) {
-    pte_t *pte_user = walk(p->pagetable, va, 0);
-    if (pte_user == 0) {
-      return -1;
+  vmwalk_init(&kw, kpgtbl, start, PGROUNDUP(end), VMWALK_ALLOC|VMWALK_MEGA);
+  for (vmwalk_init(&uw, p->pagetable, start, PGROUNDUP(end), 0); vmwalk_next(&uw); ) {
+    vmwalk_next(&kw);
+    if (uw.level == 1 && kw.level != 1) {
+      // the kernel side already has a leaf page-table page
+      // here: mirror the megapage one 4 KB page at a time.
+      a = MEGAPGROUNDDOWN(uw.va);
+      for (;;) {
+        if (kw.pte == 0)
+          return -1;
+        *kw.pte = PA2PTE(PTE2PA(*uw.pte) + (kw.va - a)) | PTE_FLAGS_UNSET_U(*uw.pte);
+        if (kw.va + PGSIZE >= a + MEGAPGSIZE || kw.va + PGSIZE >= kw.end)
+          break;
+        vmwalk_next(&kw);
+      }
+      continue;
     }
-    pte_t *pte_kernel = walk(kpgtbl, va, 1);
-    if (pte_kernel == 0) {
+    if (uw.level == 0 && kw.level == 1)
+      vmwalk_descend(&kw);
+    if (uw.pte == 0 && kw.pte == 0)
+      continue;  // neither side has a leaf page-table page here.
+    if (kw.pte == 0)
       return -1;
+    if (uw.pte == 0) {
+      *kw.pte = 0;
+      continue;
     }
-    pte_t entry = PTE_CLEAR_FLAGS(*pte_user) | PTE_FLAGS_UNSET_U(*pte_user);
-    *pte_kernel = entry;
+    *kw.pte = PTE_CLEAR_FLAGS(*uw.pte) | PTE_FLAGS_UNSET_U(*uw.pte);
   }
   return 0;
 }
@@ -0,0 +1,23 @@
+// Iterator over the PTEs that map a range of virtual addresses.
+// vmwalk_next() walks from the root only when it crosses into a
+// new leaf page-table page; the PTEs within one leaf page are
+// then visited in order. 2 MB megapages are visited once, as
+// their level-1 PTE.
+//
+//   struct vmwalk w;
+//   for(vmwalk_init(&w, pagetable, va, end, flags); vmwalk_next(&w); ){
+//     ... w.va, w.pte, w.level ...
+//   }
+struct vmwalk {
+  pagetable_t pagetable;
+  uint64 va;      // virtual address of the current page
+  uint64 end;     // one beyond the last address of the range
+  pte_t *pte;     // PTE for va, or 0 if its page-table page is missing
+  int level;      // 0: pte maps a 4 KB page; 1: a 2 MB megapage
+  int left;       // PTEs after pte in the same leaf page-table page
+  int flags;      // VMWALK_*
+  int started;    // has vmwalk_next() been called yet?
+};
+
+#define VMWALK_ALLOC  1  // create missing page-table pages
+#define VMWALK_MEGA   2  // offer empty aligned 2 MB slots as level 1
@@ -0,0 +1,455 @@
+//
+// Demand-paged user memory: exec() segments and mmap().
+//
+// A process's demand-paged regions are described by the
+// struct vma slots in p->vma. Their pages are not mapped
+// up front; the first access to each one traps, and
+// vmfault() fills it from the region's file (or with
+// zeros) and maps it in both the user and the per-process
+// kernel page table.
+//
+// A page that still matches the file is mapped read-only
+// from the page cache, shared with everyone else reading
+// it, unless the region is MAP_SHARED. The first write to
+// it gives the process a private copy (copy-on-write).
+// Dirty pages of MAP_SHARED regions are written back to the
+// file when they are unmapped.
+//
+// The kernel reaches user memory through copyin()/copyout()
+// and their relatives, which call vmfault() themselves. A
+// fault that must read a file cannot sleep if the caller
+// holds a spinlock, so system calls that copy to or from
+// user memory with locks held call vmprefault() first.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "fs.h"
+#include "file.h"
+#include "fcntl.h"
+#include "defs.h"
+
+// Return p's region containing va, or 0.
+struct vma*
+vmalookup(struct proc *p, uint64 va)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < p->vma + NVMA; v++)
+    if(v->end != 0 && va >= v->start && va < v->end)
+      return v;
+  return 0;
+}
+
+// Return an mmap() region of p that overlaps [start, end), or 0.
+struct vma*
+vmaoverlap(struct proc *p, uint64 start, uint64 end)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < p->vma + NVMA; v++)
+    if(v->end != 0 && v->flags != 0 && v->start < end && start < v->end)
+      return v;
+  return 0;
+}
+
+// Map page mem at va0 in both of p's page tables.
+// Frees mem on failure.
+static int
+vmmapin(struct proc *p, uint64 va0, char *mem, int perm)
+{
+  if(mappages(p->pagetable, va0, PGSIZE, (uint64)mem, perm|PTE_U) != 0){
+    kfree(mem);
+    return -1;
+  }
+  if(copy_pagetable_to_kernel(p->kernel_pagetable, p, va0, va0 + PGSIZE) < 0){
+    uvmunmap(p->pagetable, va0, 1, 1);
+    return -1;
+  }
+  sfence_vma();
+  return 0;
+}
+
+// Replace the shared page that pte maps at va0 with a
+// private, writable copy.
+static int
+vmcow(struct proc *p, uint64 va0, pte_t *pte)
+{
+  uint64 pa = PTE2PA(*pte);
+  char *mem;
+
+  if((mem = kalloc()) == 0)
+    return -1;
+  memmove(mem, (char*)pa, PGSIZE);
+  *pte = PA2PTE(mem) | PTE_FLAGS(*pte) | PTE_W;
+  kfree((void*)pa);
+  if(copy_pagetable_to_kernel(p->kernel_pagetable, p, va0, va0 + PGSIZE) < 0)
+    return -1;
+  sfence_vma();
+  return 0;
+}
+
+// Handle a fault on va in p, whose memory this is (p->mm == p).
+// Caller holds vmlock().
+static int
+fault(struct proc *p, uint64 va, int write)
+{
+  struct vma *v;
+  uint64 va0, off;
+  pte_t *pte;
+  uint n;
+  int perm;
+  char *mem;
+
+  va0 = PGROUNDDOWN(va);
+  if(va >= MAXVA)
+    return -1;
+
+  pte = walk(p->pagetable, va0, 0);
+  if(pte && (*pte & PTE_S)){
+    if(!cansleep() || (mem = kalloc()) == 0)
+      return -1;
+    perm = PTE_FLAGS(*pte) & ~(PTE_S|PTE_U);
+    swapin(*pte, mem);
+    *pte = 0;
+    return vmmapin(p, va0, mem, perm);
+  }
+
+  if((v = vmalookup(p, va0)) == 0)
+    return -1;
+  if(v->flags == 0 && va >= p->sz)
+    return -1;   // an exec() region that sbrk() gave back.
+  if(write && (v->perm & PTE_W) == 0)
+    return -1;
+
+  pte = walk(p->pagetable, va0, 0);
+  if(pte && (*pte & PTE_V)){
+    // mapped: only a write to a copy-on-write page may proceed.
+    if(!write || (*pte & PTE_W))
+      return -1;
+    return vmcow(p, va0, pte);
+  }
+
+  perm = v->perm;
+  off = va0 - v->start;
+  if(v->ip && off < v->filesz){
+    if(!cansleep())
+      return -1;   // cannot sleep in ilock().
+    n = v->filesz - off < PGSIZE ? v->filesz - off : PGSIZE;
+    ilock(v->ip);
+    if(v->flags != MAP_SHARED && !write && (v->off + off) % PGSIZE == 0 &&
+       (n == PGSIZE || v->off + off + n >= v->ip->size) &&
+       (mem = pcacheget(v->ip, v->off + off)) != 0){
+      // the cached page holds exactly the region's bytes:
+      // share it until the first write.
+      perm &= ~PTE_W;
+    } else if((mem = kalloc()) != 0){
+      memset(mem, 0, PGSIZE);
+      // the file may have shrunk since: leave zeros.
+      if(readi(v->ip, 0, (uint64)mem, v->off + off, n) < 0){
+        kfree(mem);
+        mem = 0;
+      }
+    }
+    iunlock(v->ip);
+    if(mem == 0)
+      return -1;
+  } else {
+    // beyond the file: zero-fill, like BSS.
+    if((mem = kalloc()) == 0)
+      return -1;
+    memset(mem, 0, PGSIZE);
+  }
+  return vmmapin(p, va0, mem, perm);
+}
+
+// Handle an access by p to va (a write, if write is set) that
+// faulted: fill in and map the page, read it back from swap,
+// or copy a copy-on-write page. Returns 0 if the access can
+// now proceed, -1 if it is not allowed or memory ran out.
+int
+vmfault(struct proc *p, uint64 va, int write)
+{
+  int r;
+
+  if(vmlock(p) < 0)
+    return -1;
+  r = fault(p->mm, va, write);
+  vmunlock(p);
+  return r;
+}
+
+// Fault in the pages of [va, va+len) that are not yet mapped
+// (or, if write is set, not yet writable), so that copying to
+// or from them later cannot sleep: demand-paged pages of p's
+// regions, and swapped-out pages of the heap and stack, which
+// lie in no region. Other addresses are left for
+// copyin()/copyout() to reject.
+// Returns 0 on success, -1 if a page could not be filled.
+int
+vmprefault(struct proc *p, uint64 va, uint64 len, int write)
+{
+  struct proc *mm = p->mm;
+  struct vma *v;
+  uint64 a, end;
+  pte_t *pte;
+
+  if(va + len < va)
+    return -1;
+  end = va + len < mm->sz ? va + len : mm->sz;
+  for(a = PGROUNDDOWN(va); a < end; a += PGSIZE){
+    pte = walk(mm->pagetable, a, 0);
+    if(pte && (*pte & PTE_S) && vmfault(p, a, write) < 0)
+      return -1;
+  }
+  for(v = mm->vma; v < mm->vma + NVMA; v++){
+    if(v->end == 0)
+      continue;
+    end = va + len < v->end ? va + len : v->end;
+    if(v->flags == 0 && end > mm->sz)
+      end = mm->sz;
+    a = PGROUNDDOWN(va) > v->start ? PGROUNDDOWN(va) : v->start;
+    for(; a < end; a += PGSIZE){
+      pte = walk(mm->pagetable, a, 0);
+      if(pte && (*pte & PTE_V) && (!write || (*pte & PTE_W)))
+        continue;
+      if(vmfault(p, a, write) < 0)
+        return -1;
+    }
+  }
+  return 0;
+}
+
+// Map len bytes of ip, from page-aligned offset off, into p at
+// an unused address below MMAPTOP and above the heap. Pages are
+// read in on first use. p is the owner of the memory (p->mm),
+// as for vmunmap(); the caller holds vmlock().
+// Returns the address, or -1.
+uint64
+vmmap(struct proc *p, uint64 len, int perm, int flags, struct inode *ip, uint off)
+{
+  struct vma *v, *w;
+  uint64 end;
+  uint size;
+
+  len = PGROUNDUP(len);
+  if(len == 0 || len > MMAPTOP)
+    return -1;
+  for(v = p->vma; v < p->vma + NVMA; v++)
+    if(v->end == 0)
+      break;
+  if(v == p->vma + NVMA)
+    return -1;
+
+  // take the highest gap that is big enough.
+  end = MMAPTOP;
+  for(;;){
+    if(end < len || end - len < PGROUNDUP(p->sz))
+      return -1;
+    if((w = vmaoverlap(p, end - len, end)) == 0)
+      break;
+    end = w->start;
+  }
+
+  ilock(ip);
+  size = ip->size;
+  iunlock(ip);
+
+  v->start = end - len;
+  v->end = end;
+  v->perm = perm;
+  v->flags = flags;
+  v->ip = idup(ip);
+  v->off = off;
+  if(off >= size)
+    v->filesz = 0;
+  else if(size - off < len)
+    v->filesz = size - off;
+  else
+    v->filesz = len;
+  return v->start;
+}
+
+// Write the dirty pages of MAP_SHARED region v that lie in
+// [start, end) back to its file.
+static void
+vmwriteback(struct proc *p, struct vma *v, uint64 start, uint64 end)
+{
+  uint64 a, off;
+  pte_t *pte;
+  uint n;
+
+  if(v->flags != MAP_SHARED)
+    return;
+  for(a = start; a < end; a += PGSIZE){
+    pte = walk(p->pagetable, a, 0);
+    if(pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_D) == 0)
+      continue;
+    off = a - v->start;
+    if(off >= v->filesz)
+      break;   // never extend the file.
+    n = v->filesz - off < PGSIZE ? v->filesz - off : PGSIZE;
+    // a page is small enough for one transaction.
+    begin_op();
+    ilock(v->ip);
+    writei(v->ip, 0, PTE2PA(*pte), v->off + off, n);
+    iunlock(v->ip);
+    end_op();
+  }
+}
+
+// Unmap [addr, addr+len) from p, which must be the current
+// process's p->mm. The range must lie within one
+// mmap() region; the region shrinks, or is split in two if the
+// range is in its middle. Dirty pages of a MAP_SHARED region
+// are written back to the file.
+// Returns 0 on success, -1 on error.
+int
+vmunmap(struct proc *p, uint64 addr, uint64 len)
+{
+  struct vma *v, *nv;
+  uint64 end, cut;
+
+  end = PGROUNDUP(addr + len);
+  if(addr % PGSIZE != 0 || end < addr)
+    return -1;
+  if(len == 0)
+    return 0;
+  if((v = vmalookup(p, addr)) == 0 || v->flags == 0 || end > v->end)
+    return -1;
+
+  if(addr > v->start && end < v->end){
+    // a hole in the middle: the part above it becomes a
+    // region of its own.
+    for(nv = p->vma; nv < p->vma + NVMA; nv++)
+      if(nv->end == 0)
+        break;
+    if(nv == p->vma + NVMA)
+      return -1;
+    *nv = *v;
+    cut = end - v->start;
+    nv->start = end;
+    nv->off += cut;
+    nv->filesz = v->filesz > cut ? v->filesz - cut : 0;
+    idup(nv->ip);
+    v->end = end;
+  }
+
+  vmwriteback(p, v, addr, end);
+  uvmunmapsync(p->pagetable, p->kernel_pagetable, addr, end);
+
+  if(addr == v->start && end == v->end){
+    begin_op();
+    iput(v->ip);
+    end_op();
+    memset(v, 0, sizeof(*v));
+  } else if(addr == v->start){
+    cut = end - v->start;
+    v->start = end;
+    v->off += cut;
+    v->filesz = v->filesz > cut ? v->filesz - cut : 0;
+  } else {
+    v->end = addr;
+  }
+  return 0;
+}
+
+// Unmap all of p's mmap() regions, as exit() and exec() must
+// before freeing the page table.
+void
+vmunmapall(struct proc *p)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < p->vma + NVMA; v++)
+    if(v->end != 0 && v->flags != 0)
+      vmunmap(p, v->start, v->end - v->start);
+}
+
+// Give np, the child of fork(), p's regions. Pages already
+// mapped in mmap() regions are shared if the region is
+// MAP_SHARED (or the page is still copy-on-write), and copied
+// otherwise; uvmcopy() has dealt with the rest of memory.
+// Returns 0 on success, -1 (having released np's regions) if
+// out of memory.
+int
+vmadup(struct proc *p, struct proc *np)
+{
+  struct vma *v;
+  uint64 a, pa;
+  pte_t *pte, *npte;
+  char *mem;
+  int i;
+
+  for(i = 0; i < NVMA; i++){
+    np->vma[i] = p->vma[i];
+    if(np->vma[i].end != 0 && np->vma[i].ip)
+      idup(np->vma[i].ip);
+  }
+
+  for(v = p->vma; v < p->vma + NVMA; v++){
+    if(v->end == 0 || v->flags == 0)
+      continue;
+    for(a = v->start; a < v->end; a += PGSIZE){
+      pte = walk(p->pagetable, a, 0);
+      if(pte && (*pte & PTE_S)){
+        // swapped out: the child shares the swap slot.
+        if((npte = walk(np->pagetable, a, 1)) == 0)
+          goto bad;
+        swapdup(*pte);
+        *npte = *pte;
+        continue;
+      }
+      if(pte == 0 || (*pte & PTE_V) == 0)
+        continue;
+      pa = PTE2PA(*pte);
+      if(v->flags == MAP_PRIVATE && (*pte & PTE_W)){
+        if((mem = kalloc()) == 0)
+          goto bad;
+        memmove(mem, (char*)pa, PGSIZE);
+        pa = (uint64)mem;
+      } else {
+        kdup((void*)pa);
+      }
+      if(mappages(np->pagetable, a, PGSIZE, pa, PTE_FLAGS(*pte)) != 0){
+        kfree((void*)pa);
+        goto bad;
+      }
+    }
+    if(copy_pagetable_to_kernel(np->kernel_pagetable, np, v->start, v->end) < 0)
+      goto bad;
+  }
+  return 0;
+
+ bad:
+  for(v = np->vma; v < np->vma + NVMA; v++){
+    if(v->end == 0 || v->flags == 0)
+      continue;
+    uvmunmap(np->pagetable, v->start, (v->end - v->start) / PGSIZE, 1);
+    clear_pte(np->kernel_pagetable, v->start, v->end);
+  }
+  begin_op();
+  vmaput(np->vma);
+  end_op();
+  return -1;
+}
+
+// Release the regions in vma[NVMA]. Any mmap() regions must
+// already have been unmapped.
+// Must be called inside a transaction, since it calls iput().
+void
+vmaput(struct vma *vma)
+{
+  struct vma *v;
+
+  for(v = vma; v < vma + NVMA; v++){
+    if(v->end != 0 && v->ip)
+      iput(v->ip);
+    memset(v, 0, sizeof(*v));
+  }
+}
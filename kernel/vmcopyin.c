@@ -2,6 +2,8 @@
 #include "types.h"
 #include "memlayout.h"
 #include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
 #include "defs.h"
 #include "fs.h"
 
@@ -11,6 +13,74 @@ k doesn't have PTE_U set, u sets PTE_U
 the mapping should below PLIC
 the user process has no alloc(), they are grown with sbrk
 */
+
+/*
+in a process with threads, another thread may unmap a page, and
+clear its kernel PTE, between the walkaddr() check and the read
+through srcva, which would then fault in the kernel. so such
+processes copy by physical address, a page at a time with
+interrupts off: the thread stays RUNNING meanwhile, and tlbsync()
+waits for it before the unmapped page is freed.
+*/
+
+// Copy n bytes at srcva, all in one page, to dst; if str is set,
+// stop after a '\0'. Returns the number of bytes copied, or -1 if
+// the page is not mapped.
+static int
+copypage(pagetable_t pagetable, char *dst, uint64 srcva, uint64 n, int str)
+{
+    uint64 pa0, i;
+    char *src;
+
+    push_off();
+    pa0 = walkaddr(pagetable, PGROUNDDOWN(srcva));
+    if (pa0 == 0) {
+        pop_off();
+        return -1;
+    }
+    src = (char *)(pa0 + (srcva - PGROUNDDOWN(srcva)));
+    if (str) {
+        for (i = 0; i < n; i++) {
+            if ((dst[i] = src[i]) == '\0') {
+                i++;
+                break;
+            }
+        }
+    } else {
+        memmove(dst, src, n);
+        i = n;
+    }
+    pop_off();
+    return i;
+}
+
+// copyin_new() and copyinstr_new() for a process with threads.
+// Returns 0 on success, -1 on a bad address, -2 if str is set
+// and there is no '\0' within len bytes.
+static int
+copyin_threads(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len, int str)
+{
+    uint64 n, va0;
+    int m;
+
+    while (len > 0) {
+        va0 = PGROUNDDOWN(srcva);
+        if (walkaddr(pagetable, va0) == 0 && vmfault(myproc(), va0, 0) < 0)
+            return -1;   // not mapped, nor demand-paged
+        n = PGSIZE - (srcva - va0);
+        if (n > len)
+            n = len;
+        if ((m = copypage(pagetable, dst, srcva, n, str)) < 0)
+            return -1;
+        if (str && dst[m - 1] == '\0')
+            return 0;
+        len -= m;
+        dst += m;
+        srcva += m;
+    }
+    return str ? -2 : 0;
+}
+
 int 
 copyin_new(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 {   
@@ -20,9 +90,14 @@ copyin_new(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
     if (srcva + len >= PLIC) {
         return -1;
     }
+    if (myproc()->mm->nthread > 1) {
+        return copyin_threads(pagetable, dst, srcva, len, 0);
+    }
     uint64 pa0;
     for (uint64 va0 = PGROUNDDOWN(srcva); va0 < PGROUNDUP(srcva + len); va0 += PGSIZE) {
         pa0 = walkaddr(pagetable, va0);
+        if (pa0 == 0 && vmfault(myproc(), va0, 0) == 0)
+            pa0 = walkaddr(pagetable, va0);  // demand-paged
         if (pa0 == 0)
             return -1;
     }
@@ -31,7 +106,10 @@ copyin_new(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 }
 
 
-uint64
+// Return the length of the string at srcva, counting its nul;
+// -1 if it runs into a bad address, or -2 if there is no nul in
+// the first max bytes.
+int
 get_length_to_null(pagetable_t pagetable, uint64 srcva, uint64 max)
 {
     int i = 0;
@@ -43,6 +121,8 @@ get_length_to_null(pagetable_t pagetable, uint64 srcva, uint64 max)
             return -1;
         }
         pa0 = walkaddr(pagetable, va0);
+        if (pa0 == 0 && vmfault(myproc(), va0, 0) == 0)
+            pa0 = walkaddr(pagetable, va0);  // demand-paged
         if (pa0 == 0)
             return -1;
         p = (char *) (va0);
@@ -51,7 +131,7 @@ get_length_to_null(pagetable_t pagetable, uint64 srcva, uint64 max)
         }
     }
     if (i == max) {
-        return -1;
+        return -2;
     }
     return i + 1;
 }
@@ -59,13 +139,25 @@ get_length_to_null(pagetable_t pagetable, uint64 srcva, uint64 max)
 // Copy a null-terminated string from user to kernel.
 // Copy bytes to dst from virtual address srcva in a given page table,
 // until a '\0', or max.
-// Return 0 on success, -1 on error.
+// Return 0 on success, -1 on a bad address, -2 if there is no
+// '\0' within max bytes.
 int 
 copyinstr_new(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 {
-    uint64 len = get_length_to_null(pagetable, srcva, max);
+    if (myproc()->mm->nthread > 1) {
+        if (srcva >= PLIC) {
+            return -1;
+        }
+        if (max > PLIC - srcva) {
+            // running into PLIC is a bad address.
+            int r = copyin_threads(pagetable, dst, srcva, PLIC - srcva, 1);
+            return r == -2 ? -1 : r;
+        }
+        return copyin_threads(pagetable, dst, srcva, max, 1);
+    }
+    int len = get_length_to_null(pagetable, srcva, max);
     if (len < 0) {
-        return -1;
+        return len;
     }
     if ((uint64)dst + len < (uint64)dst) {
         return -1;
@@ -0,0 +1,96 @@
+//
+// Working-set sampling.
+//
+// Every WSINTERVAL clock ticks, a running process counts, at
+// the timer interrupt that would reschedule it, its resident
+// pages and how many of them it has used since the previous
+// sample, from their PTE_A bits. wsinfo() reports the latest
+// sample. Like sys_pgaccess(), sampling clears PTE_A but sets
+// PTE_SA, so that swap.c's CLOCK still sees the page as used.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fcntl.h"
+#include "vm.h"
+#include "wsinfo.h"
+#include "defs.h"
+
+// Add the pages of pagetable in [start, end) to ws.
+static void
+count(pagetable_t pagetable, uint64 start, uint64 end, struct wsinfo *ws)
+{
+  struct vmwalk w;
+  uint64 n, next;
+
+  for(vmwalk_init(&w, pagetable, start, end, 0); vmwalk_next(&w); ){
+    if(w.pte == 0)
+      continue;
+    if(*w.pte & PTE_S){
+      ws->swapped++;
+      continue;
+    }
+    if((*w.pte & (PTE_V|PTE_U)) != (PTE_V|PTE_U) || !PTE_LEAF(*w.pte))
+      continue;
+    n = 1;
+    if(w.level == 1){
+      next = MEGAPGROUNDDOWN(w.va) + MEGAPGSIZE;
+      n = ((next < w.end ? next : w.end) - w.va) / PGSIZE;
+    }
+    ws->resident += n;
+    if(*w.pte & PTE_A){
+      *w.pte = (*w.pte & ~PTE_A) | PTE_SA;
+      ws->touched += n;
+    }
+  }
+}
+
+// Sample p's working set if WSINTERVAL ticks have passed since
+// the last sample. Called by p itself from usertrap().
+void
+wssample(struct proc *p)
+{
+  struct wsinfo ws;
+  struct proc *mm = p->mm;
+  struct vma *v;
+
+  if(ticks - p->wstick < WSINTERVAL)
+    return;
+  memset(&ws, 0, sizeof(ws));
+  count(p->pagetable, 0, mm->sz, &ws);
+  for(v = mm->vma; v < mm->vma + NVMA; v++)
+    if(v->end != 0 && v->flags != 0)
+      count(p->pagetable, v->start, v->end, &ws);
+  sfence_vma();   // so that the next use sets PTE_A again
+  ws.ticks = ticks;
+
+  acquire(&p->lock);
+  p->wsresident = ws.resident;
+  p->wstouched = ws.touched;
+  p->wsswapped = ws.swapped;
+  p->wstick = ws.ticks;
+  release(&p->lock);
+}
+
+// Copy the latest sample of process pid (the caller, if pid
+// is 0) into *ws. Returns 0, or -1 if there is no such process.
+int
+wsget(int pid, struct wsinfo *ws)
+{
+  struct proc *p;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+  if((p = findproc(pid)) == 0)
+    return -1;
+  ws->resident = p->wsresident;
+  ws->touched = p->wstouched;
+  ws->swapped = p->wsswapped;
+  ws->ticks = p->wstick;
+  release(&p->lock);
+  return 0;
+}
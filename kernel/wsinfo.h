@@ -0,0 +1,7 @@
+// A process's working set, as last sampled (see wset.c).
+struct wsinfo {
+  uint64 resident;  // pages of user memory in RAM
+  uint64 touched;   // of those, pages used since the sample before
+  uint64 swapped;   // pages of user memory in swap
+  uint ticks;       // when the sample was taken
+};
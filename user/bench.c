@@ -0,0 +1,328 @@
+// Kernel microbenchmarks. Each prints one line,
+//   name value unit
+// with times in timer cycles (rdtime, which start() lets user
+// mode read), the best of a few runs.
+//   bench [name...]
+// runs the named benchmarks, or all of them.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+#define NRUN 3              // runs of each; the fastest counts
+#define FILESZ (128*1024)   // bytes in the read/write file
+
+char buf[8192];
+
+// The cost of one op of fn(n), n ops per call, as the best
+// of NRUN runs.
+uint64
+best(void (*fn)(int), int n)
+{
+  uint64 t, min;
+  int i;
+
+  min = 0;
+  for(i = 0; i < NRUN; i++){
+    t = r_time();
+    fn(n);
+    t = r_time() - t;
+    if(i == 0 || t < min)
+      min = t;
+  }
+  return min / n;
+}
+
+void
+die(char *what)
+{
+  fprintf(2, "bench: %s failed\n", what);
+  exit(1);
+}
+
+void
+null(int n)
+{
+  while(n-- > 0)
+    getpid();
+}
+
+void
+forkwait(int n)
+{
+  int pid;
+
+  while(n-- > 0){
+    if((pid = fork()) < 0)
+      die("fork");
+    if(pid == 0)
+      exit(0);
+    wait(0);
+  }
+}
+
+void
+forkexec(int n)
+{
+  char *argv[] = { "bench", "-x", 0 };
+  int pid;
+
+  while(n-- > 0){
+    if((pid = fork()) < 0)
+      die("fork");
+    if(pid == 0){
+      exec(argv[0], argv);
+      die("exec");
+    }
+    wait(0);
+  }
+}
+
+// n round trips of a byte between this process and a child.
+void
+pipelat(int n)
+{
+  int p1[2], p2[2], i;
+  char c = 0;
+
+  if(pipe(p1) < 0 || pipe(p2) < 0)
+    die("pipe");
+  if(fork() == 0){
+    for(i = 0; i < n; i++){
+      read(p1[0], &c, 1);
+      write(p2[1], &c, 1);
+    }
+    exit(0);
+  }
+  for(i = 0; i < n; i++){
+    write(p1[1], &c, 1);
+    read(p2[0], &c, 1);
+  }
+  wait(0);
+  close(p1[0]);
+  close(p1[1]);
+  close(p2[0]);
+  close(p2[1]);
+}
+
+// n KB through a pipe to a child.
+void
+pipebw(int n)
+{
+  int p[2], m;
+
+  if(pipe(p) < 0)
+    die("pipe");
+  if(fork() == 0){
+    close(p[1]);
+    while(read(p[0], buf, sizeof(buf)) > 0)
+      ;
+    exit(0);
+  }
+  close(p[0]);
+  for(m = 0; m < n; m += 4)
+    write(p[1], buf, 4096);
+  close(p[1]);
+  wait(0);
+}
+
+void
+creat(int n)
+{
+  int fd;
+
+  while(n-- > 0){
+    if((fd = open("bench.tmp", O_CREATE|O_RDWR)) < 0)
+      die("create");
+    close(fd);
+    unlink("bench.tmp");
+  }
+}
+
+// Write a file of n KB, in 4 KB writes.
+void
+seqwrite(int n)
+{
+  int fd, m;
+
+  unlink("bench.dat");
+  unlink("bench.out");
+  if((fd = open("bench.dat", O_CREATE|O_RDWR)) < 0)
+    die("create");
+  for(m = 0; m < n; m += 4)
+    if(write(fd, buf, 4096) != 4096)
+      die("write");
+  close(fd);
+}
+
+// Read n KB of the file, in 4 KB reads.
+void
+seqread(int n)
+{
+  int fd, m;
+
+  if((fd = open("bench.dat", O_RDONLY)) < 0)
+    die("open");
+  for(m = 0; m < n; m += 4)
+    if(read(fd, buf, 4096) != 4096)
+      die("read");
+  close(fd);
+}
+
+// Touch n pages of the file at random, through mmap(), since
+// there is no lseek().
+void
+randread(int n)
+{
+  int fd, i;
+  uint x;
+  volatile char *p;
+
+  if((fd = open("bench.dat", O_RDONLY)) < 0)
+    die("open");
+  p = mmap(0, FILESZ, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(p == (char*)-1)
+    die("mmap");
+  x = 12345;
+  for(i = 0; i < n; i++){
+    x = x * 1103515245 + 12345;
+    (void)p[(x >> 8) % (FILESZ / 4096) * 4096];
+  }
+  munmap((void*)p, FILESZ);
+}
+
+// Grow the heap by n pages, one at a time, touching each.
+void
+grow(int n)
+{
+  char *p;
+  int i;
+
+  for(i = 0; i < n; i++){
+    if((p = sbrk(4096)) == (char*)-1)
+      die("sbrk");
+    *p = 1;
+  }
+  sbrk(-n * 4096);
+}
+
+// Two threads take turns n times, each waking the other and
+// waiting in futex_wait(): two context switches a turn on one
+// CPU.
+int turn;
+
+void
+ponger(void *arg)
+{
+  int i, n = (int)(uint64)arg;
+
+  for(i = 0; i < n; i++){
+    while(turn != 1)
+      futex_wait(&turn, 0);
+    turn = 0;
+    futex_wake(&turn, 1);
+  }
+  exit(0);
+}
+
+void
+ctxsw(int n)
+{
+  int i, tid;
+
+  turn = 0;
+  if((tid = thread_create(ponger, (void*)(uint64)n)) < 0)
+    die("thread_create");
+  for(i = 0; i < n; i++){
+    turn = 1;
+    futex_wake(&turn, 1);
+    while(turn != 0)
+      futex_wait(&turn, 1);
+  }
+  thread_join(tid);
+}
+
+// n lines of formatted output to a file, with the file
+// buffered as mode says.
+void
+printlines(int n, int mode)
+{
+  int fd, i;
+
+  if((fd = open("bench.out", O_CREATE|O_TRUNC|O_WRONLY)) < 0)
+    die("open");
+  if(setvbuf(fd, mode) < 0)
+    die("setvbuf");
+  for(i = 0; i < n; i++)
+    fprintf(fd, "line %d of %d: %s\n", i, n, "some text");
+  fflush(fd);
+  setvbuf(fd, _IONBF);
+  close(fd);
+}
+
+void
+printcall(int n)
+{
+  printlines(n, _IONBF);
+}
+
+void
+printline(int n)
+{
+  printlines(n, _IOLBF);
+}
+
+void
+printfull(int n)
+{
+  printlines(n, _IOFBF);
+}
+
+struct {
+  char *name;
+  void (*fn)(int);
+  int n;
+  char *unit;
+} benches[] = {
+  { "null",      null,      10000, "cycles/call" },
+  { "fork",      forkwait,  100,   "cycles/fork+exit+wait" },
+  { "forkexec",  forkexec,  30,    "cycles/fork+exec+wait" },
+  { "pipelat",   pipelat,   1000,  "cycles/round-trip" },
+  { "pipebw",    pipebw,    1024,  "cycles/KB" },
+  { "create",    creat,     50,    "cycles/create+unlink" },
+  { "seqwrite",  seqwrite,  FILESZ/1024, "cycles/KB" },
+  { "seqread",   seqread,   FILESZ/1024, "cycles/KB" },
+  { "randread",  randread,  1000,  "cycles/page" },
+  { "sbrk",      grow,      256,   "cycles/page" },
+  { "ctxsw",     ctxsw,     1000,  "cycles/switch-pair" },
+  { "printf",    printcall, 500,   "cycles/line" },
+  { "printfline", printline, 500,  "cycles/line" },
+  { "printffull", printfull, 500,  "cycles/line" },
+};
+
+int
+main(int argc, char *argv[])
+{
+  int i, j, run;
+
+  if(argc > 1 && strcmp(argv[1], "-x") == 0)
+    exit(0);    // forkexec's child
+
+  for(i = 0; i < sizeof(benches)/sizeof(benches[0]); i++){
+    run = argc == 1;
+    for(j = 1; j < argc; j++)
+      if(strcmp(argv[j], benches[i].name) == 0)
+        run = 1;
+    // the read benchmarks need the file seqwrite makes.
+    if(run && (benches[i].fn == seqread || benches[i].fn == randread))
+      seqwrite(FILESZ/1024);
+    if(run)
+      printf("%s %l %s\n", benches[i].name, best(benches[i].fn, benches[i].n), benches[i].unit);
+  }
+  unlink("bench.dat");
+  printf("bench: done\n");
+  exit(0);
+}
@@ -0,0 +1,176 @@
+// Stress the buddy page allocator.
+//
+// Many processes grow one page at a time, so that their pages
+// interleave in physical memory; killing every other one then
+// leaves free memory fragmented. A large sbrk() must still
+// succeed from the fragments, and once every process is gone
+// the free pages must coalesce back into large blocks.
+//
+// The test does no file I/O, so the page cache does not change
+// meanwhile. The slab caches do: the pipe and file caches may
+// each end up keeping an empty slab, and a slab pinned by an
+// object left in a per-CPU magazine, so up to SLACK pages may
+// stay allocated. Each such page can break up one block of
+// order >= BIGORDER, which costs at most 2^BIGORDER pages of
+// those blocks.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+#define NCHILD  16
+#define NPAGE   256   // pages grown by each child
+#define BIG     (8*1024*1024)
+#define MAXORDER 10
+#define BIGORDER 4    // blocks this large count as coalesced
+#define SLACK   4     // 2 slab caches * 2 slabs (see above)
+
+char buf[4096];
+
+// Return s with prefix skipped, or 0 if s does not start with it.
+char*
+skip(char *s, char *prefix)
+{
+  int n = strlen(prefix);
+
+  if(memcmp(s, prefix, n) != 0)
+    return 0;
+  return s + n;
+}
+
+// Read the allocator's free-block counts into nfree[], from
+// lines of the form "kalloc: order K free blocks N".
+// Returns the total number of free pages.
+int
+readfree(int *nfree)
+{
+  char *s, *t;
+  int n, k, total = -1;
+
+  n = statistics(buf, sizeof(buf) - 1);
+  if(n <= 0){
+    printf("buddytest: cannot read statistics\n");
+    exit(1);
+  }
+  buf[n] = 0;
+  for(k = 0; k <= MAXORDER; k++)
+    nfree[k] = -1;
+  for(s = buf; *s; s++){
+    if(s != buf && s[-1] != '\n')
+      continue;
+    if((t = skip(s, "kalloc: free pages ")) != 0){
+      total = atoi(t);
+    } else if((t = skip(s, "kalloc: order ")) != 0){
+      k = atoi(t);
+      t = strchr(t, 's');   // "blocks "
+      if(t && k >= 0 && k <= MAXORDER)
+        nfree[k] = atoi(t + 2);
+    }
+  }
+  return total;
+}
+
+// Grow one page at a time, writing to each page, then tell
+// the parent and wait to be killed.
+void
+grow(int fd)
+{
+  char *p;
+  int i;
+
+  for(i = 0; i < NPAGE; i++){
+    p = sbrk(PGSIZE);
+    if(p == (char*)-1)
+      break;
+    *p = i;
+    if(i % 16 == 0)
+      sleep(0);
+  }
+  write(fd, "x", 1);
+  for(;;)
+    sleep(100);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int before[MAXORDER+1], after[MAXORDER+1];
+  int pids[NCHILD];
+  int fds[2], i, k, pid, xstatus;
+  int freebefore, freeafter, bigbefore, bigafter;
+  char c;
+
+  printf("buddytest starting\n");
+  freebefore = readfree(before);
+
+  if(pipe(fds) < 0){
+    printf("buddytest: pipe failed\n");
+    exit(1);
+  }
+  for(i = 0; i < NCHILD; i++){
+    pids[i] = fork();
+    if(pids[i] < 0){
+      printf("buddytest: fork failed\n");
+      exit(1);
+    }
+    if(pids[i] == 0){
+      close(fds[0]);
+      grow(fds[1]);
+    }
+  }
+  for(i = 0; i < NCHILD; i++)
+    read(fds[0], &c, 1);
+  close(fds[0]);
+  close(fds[1]);
+
+  // free every other child's interleaved pages.
+  for(i = 0; i < NCHILD; i += 2){
+    kill(pids[i]);
+    wait(0);
+  }
+
+  // a big allocation must still find memory among the holes.
+  pid = fork();
+  if(pid == 0){
+    char *p = sbrk(BIG);
+    if(p == (char*)-1){
+      printf("buddytest: sbrk(%d) failed after fragmentation\n", BIG);
+      exit(1);
+    }
+    for(i = 0; i < BIG; i += PGSIZE)
+      p[i] = i;
+    for(i = 0; i < BIG; i += PGSIZE)
+      if(p[i] != (char)i){
+        printf("buddytest: wrong value in big region\n");
+        exit(1);
+      }
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(1);
+
+  for(i = 1; i < NCHILD; i += 2){
+    kill(pids[i]);
+    wait(0);
+  }
+
+  freeafter = readfree(after);
+  if(freeafter < freebefore - SLACK){
+    printf("buddytest: %d free pages before, %d after\n", freebefore, freeafter);
+    exit(1);
+  }
+  bigbefore = bigafter = 0;
+  for(k = BIGORDER; k <= MAXORDER; k++){
+    bigbefore += before[k] << k;
+    bigafter += after[k] << k;
+  }
+  if(bigafter < bigbefore - (SLACK << BIGORDER)){
+    printf("buddytest: %d pages in blocks of order >= %d before, %d after\n",
+           bigbefore, BIGORDER, bigafter);
+    exit(1);
+  }
+  printf("buddytest: OK\n");
+  exit(0);
+}
@@ -0,0 +1,32 @@
+// Print the kernel log that has not been read yet, one
+// CPU's after another.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+char buf[512];
+
+int
+main(int argc, char *argv[])
+{
+  int fd, n;
+
+  if((fd = open("klog", O_RDONLY)) < 0){
+    fprintf(2, "dmesg: cannot open klog\n");
+    exit(1);
+  }
+  while((n = read(fd, buf, sizeof(buf))) > 0){
+    if(write(1, buf, n) != n){
+      fprintf(2, "dmesg: write error\n");
+      exit(1);
+    }
+  }
+  if(n < 0){
+    fprintf(2, "dmesg: read error\n");
+    exit(1);
+  }
+  close(fd);
+  exit(0);
+}
@@ -0,0 +1,144 @@
+// Contention benchmark: threads take turns incrementing a
+// shared counter under a lock, first a mutex that sleeps in
+// futex_wait(), then a spinlock; then a producer and consumers
+// pass items through a buffer guarded by condition variables.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NINC    20000   // increments per thread
+#define NITEM   20000   // items through the buffer
+#define NBUF    8
+#define MAXT    8
+
+struct mutex m;
+int spin;
+int counter;
+
+struct cond notfull, notempty;
+int buf[NBUF];
+int nbuf, head, consumed;
+int sum;
+
+void
+mutexworker(void *arg)
+{
+  int i;
+
+  for(i = 0; i < NINC; i++){
+    mutex_lock(&m);
+    counter++;
+    mutex_unlock(&m);
+  }
+  exit(0);
+}
+
+void
+spinworker(void *arg)
+{
+  int i;
+
+  for(i = 0; i < NINC; i++){
+    while(__sync_lock_test_and_set(&spin, 1) != 0)
+      ;
+    counter++;
+    __sync_lock_release(&spin);
+  }
+  exit(0);
+}
+
+void
+consumer(void *arg)
+{
+  for(;;){
+    mutex_lock(&m);
+    while(nbuf == 0 && consumed < NITEM)
+      cond_wait(&notempty, &m);
+    if(consumed == NITEM){
+      mutex_unlock(&m);
+      exit(0);
+    }
+    sum += buf[(head + NBUF - nbuf) % NBUF];
+    nbuf--;
+    if(++consumed == NITEM)
+      cond_broadcast(&notempty);
+    cond_signal(&notfull);
+    mutex_unlock(&m);
+  }
+}
+
+// Run nt copies of fn; returns the ticks taken.
+int
+run(void (*fn)(void*), int nt)
+{
+  int i, t0, tid[MAXT];
+
+  t0 = uptime();
+  for(i = 0; i < nt; i++){
+    if((tid[i] = thread_create(fn, 0)) < 0){
+      printf("futexbench: thread_create failed\n");
+      exit(1);
+    }
+  }
+  for(i = 0; i < nt; i++)
+    thread_join(tid[i]);
+  return uptime() - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nt, maxt, i, t0, tm, ts, tid[MAXT];
+
+  maxt = argc > 1 ? atoi(argv[1]) : 4;
+  if(maxt < 1 || maxt > MAXT){
+    printf("usage: futexbench [threads <= %d]\n", MAXT);
+    exit(1);
+  }
+
+  printf("ticks for %d increments per thread\n", NINC);
+  mutex_init(&m);
+  for(nt = 1; nt <= maxt; nt++){
+    counter = 0;
+    tm = run(mutexworker, nt);
+    if(counter != nt * NINC){
+      printf("futexbench: mutex lost increments: %d\n", counter);
+      exit(1);
+    }
+    counter = 0;
+    ts = run(spinworker, nt);
+    if(counter != nt * NINC){
+      printf("futexbench: spinlock lost increments: %d\n", counter);
+      exit(1);
+    }
+    printf("%d threads: mutex %d, spinlock %d\n", nt, tm, ts);
+  }
+
+  cond_init(&notfull);
+  cond_init(&notempty);
+  for(nt = 1; nt <= maxt; nt++){
+    nbuf = head = consumed = sum = 0;
+    t0 = uptime();
+    for(i = 0; i < nt; i++)
+      tid[i] = thread_create(consumer, 0);
+    for(i = 1; i <= NITEM; i++){
+      mutex_lock(&m);
+      while(nbuf == NBUF)
+        cond_wait(&notfull, &m);
+      buf[head] = i;
+      head = (head + 1) % NBUF;
+      nbuf++;
+      cond_signal(&notempty);
+      mutex_unlock(&m);
+    }
+    for(i = 0; i < nt; i++)
+      thread_join(tid[i]);
+    if(sum != NITEM * (NITEM + 1) / 2){
+      printf("futexbench: consumers summed %d\n", sum);
+      exit(1);
+    }
+    printf("%d consumers: %d items in %d ticks\n", nt, NITEM, uptime() - t0);
+  }
+  exit(0);
+}
@@ -23,6 +23,12 @@ main(void)
   dup(0);  // stdout
   dup(0);  // stderr
 
+  // create the other devices, unless they exist already.
+  mknod("statistics", STATS, 0);
+  mknod("profile", PROF, 0);
+  mknod("trace", TRACEDEV, 0);
+  mknod("klog", KLOG, 0);
+
   for(;;){
     printf("init: starting sh\n");
     pid = fork();
@@ -0,0 +1,209 @@
+// Trace kernel events while a command runs:
+//   ktrace [-c cat,...] [-j] cmd [args...]
+//
+// Turns on the event categories named (all by default), runs
+// cmd, and prints the events of all CPUs merged into one
+// timeline: as text, or with -j as Chrome trace JSON (load it
+// in chrome://tracing or Perfetto), with each CPU as a thread
+// and the time each process ran on it as a slice.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/memlayout.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+#define MAXEVENT (NCPU * NTRACEEVENT)
+#define CYCLESUS (TIMEBASE / 1000000)   // timer cycles per microsecond
+
+char *cats[NTRACECAT] = {
+[TC_BIO]     "bio",
+[TC_DISK]    "disk",
+[TC_KALLOC]  "kalloc",
+[TC_SCHED]   "sched",
+[TC_LOG]     "log",
+[TC_SLEEP]   "sleep",
+};
+
+struct {
+  int id;
+  char *name;
+  char *arg0;
+  char *arg1;
+} events[] = {
+  { TE_BREADMISS,  "bread-miss",  "dev", "block" },
+  { TE_BWRITE,     "bwrite",      "dev", "block" },
+  { TE_DISKSUBMIT, "disk-submit", "block", "write" },
+  { TE_DISKDONE,   "disk-done",   "block", 0 },
+  { TE_KALLOCFAIL, "kalloc-fail", "order", 0 },
+  { TE_SWITCHIN,   "switch-in",   "pid", 0 },
+  { TE_SWITCHOUT,  "switch-out",  "pid", "state" },
+  { TE_OPWAIT,     "op-wait",     "outstanding", "committing" },
+  { TE_OPBEGIN,    "op-begin",    "outstanding", 0 },
+  { TE_OPEND,      "op-end",      "outstanding", 0 },
+  { TE_COMMIT,     "commit",      "blocks", 0 },
+  { TE_COMMITDONE, "commit-done", 0, 0 },
+  { TE_SLEEP,      "sleep",       "chan", 0 },
+  { TE_WAKEUP,     "wakeup",      "pid", "chan" },
+};
+
+struct traceevent ev[MAXEVENT];
+int start[NCPU+1];        // each CPU's events are ev[start[c]..start[c+1])
+
+int
+lookup(int id)
+{
+  int i;
+
+  for(i = 0; i < sizeof(events)/sizeof(events[0]); i++)
+    if(events[i].id == id)
+      return i;
+  return -1;
+}
+
+// Parse a comma-separated list of category names.
+int
+parsecats(char *s)
+{
+  char *e;
+  int c, mask;
+
+  mask = 0;
+  for(; *s; s = *e ? e + 1 : e){
+    for(e = s; *e && *e != ','; e++)
+      ;
+    for(c = 0; c < NTRACECAT; c++)
+      if(strlen(cats[c]) == e - s && memcmp(cats[c], s, e - s) == 0)
+        break;
+    if(c == NTRACECAT){
+      fprintf(2, "ktrace: no category %s\n", s);
+      exit(1);
+    }
+    mask |= 1 << c;
+  }
+  return mask;
+}
+
+void
+show(struct traceevent *e, uint64 t0, int json, int first)
+{
+  int i = lookup(e->id);
+  uint64 us = (e->time - t0) / CYCLESUS;
+
+  if(!json){
+    printf("%l\tcpu%d\tpid %d\t%s", us, e->cpu, e->pid, i >= 0 ? events[i].name : "?");
+    if(i >= 0 && events[i].arg0)
+      printf(" %s=%l", events[i].arg0, e->arg0);
+    if(i >= 0 && events[i].arg1)
+      printf(" %s=%l", events[i].arg1, e->arg1);
+    printf("\n");
+    return;
+  }
+
+  printf("%s\n", first ? "" : ",");
+  if(e->id == TE_SWITCHIN || e->id == TE_SWITCHOUT){
+    // a slice on the CPU's row for each time a process ran.
+    printf("{\"name\":\"pid %l\",\"ph\":\"%s\",\"ts\":%l,\"pid\":0,\"tid\":%d}",
+           e->arg0, e->id == TE_SWITCHIN ? "B" : "E", us, e->cpu);
+    return;
+  }
+  printf("{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%l,\"pid\":0,\"tid\":%d,\"args\":{\"pid\":%d",
+         i >= 0 ? events[i].name : "?", us, e->cpu, e->pid);
+  if(i >= 0 && events[i].arg0)
+    printf(",\"%s\":%l", events[i].arg0, e->arg0);
+  if(i >= 0 && events[i].arg1)
+    printf(",\"%s\":%l", events[i].arg1, e->arg1);
+  printf("}}");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, m, c, bc, fd, pid, mask, json, next[NCPU];
+  struct traceevent *e, *best;
+  uint64 t0;
+
+  mask = (1 << NTRACECAT) - 1;
+  json = 0;
+  for(i = 1; i < argc && argv[i][0] == '-'; i++){
+    if(strcmp(argv[i], "-j") == 0)
+      json = 1;
+    else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+      mask = parsecats(argv[++i]);
+    else
+      break;
+  }
+  if(i >= argc){
+    fprintf(2, "usage: ktrace [-c cat,...] [-j] cmd [args...]\n");
+    exit(1);
+  }
+
+  // throw away events from before.
+  if((fd = open("trace", O_RDONLY)) < 0){
+    fprintf(2, "ktrace: cannot open trace\n");
+    exit(1);
+  }
+  while(read(fd, ev, sizeof(ev)) > 0)
+    ;
+
+  tracemask(mask);
+  pid = fork();
+  if(pid < 0){
+    tracemask(0);
+    fprintf(2, "ktrace: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(fd);
+    exec(argv[i], argv + i);
+    fprintf(2, "ktrace: exec %s failed\n", argv[i]);
+    exit(1);
+  }
+  wait(0);
+  tracemask(0);
+
+  // the device returns each CPU's events in order, one CPU
+  // after another.
+  n = 0;
+  while(n < MAXEVENT && (m = read(fd, &ev[n], (MAXEVENT - n) * sizeof(ev[0]))) > 0)
+    n += m / sizeof(ev[0]);
+  close(fd);
+  for(c = 0, i = 0; c < NCPU; c++){
+    start[c] = i;
+    while(i < n && ev[i].cpu == c)
+      i++;
+  }
+  start[NCPU] = n;
+
+  // merge the CPUs' runs by time.
+  if(json)
+    printf("[");
+  t0 = n > 0 ? ev[0].time : 0;
+  for(c = 0; c < NCPU; c++){
+    next[c] = start[c];
+    if(next[c] < start[c+1] && ev[next[c]].time < t0)
+      t0 = ev[next[c]].time;
+  }
+  for(i = 0; i < n; i++){
+    best = 0;
+    bc = 0;
+    for(c = 0; c < NCPU; c++){
+      if(next[c] == start[c+1])
+        continue;
+      e = &ev[next[c]];
+      if(best == 0 || e->time < best->time){
+        best = e;
+        bc = c;
+      }
+    }
+    next[bc]++;
+    show(best, t0, json, i == 0);
+  }
+  if(json)
+    printf("\n]\n");
+  else
+    printf("%d events\n", n);
+  exit(0);
+}
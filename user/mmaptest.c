@@ -0,0 +1,230 @@
+// Tests for mmap() and munmap().
+
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define FSZ (PGSIZE + PGSIZE/2)   // a page and a half
+
+char buf[3*PGSIZE];
+
+void
+err(char *why)
+{
+  printf("mmaptest: %s failed\n", why);
+  exit(1);
+}
+
+// Create f holding FSZ bytes: 'A's, then 'B's in the second page.
+void
+makefile(char *f)
+{
+  int fd;
+
+  unlink(f);
+  if((fd = open(f, O_WRONLY | O_CREATE)) < 0)
+    err("create");
+  memset(buf, 'A', PGSIZE);
+  memset(buf + PGSIZE, 'B', FSZ - PGSIZE);
+  if(write(fd, buf, FSZ) != FSZ)
+    err("write");
+  close(fd);
+}
+
+// Check that p holds f's contents, with zeros after end of file
+// to the end of the page.
+void
+checkmap(char *p, char *why)
+{
+  int i;
+
+  for(i = 0; i < 2*PGSIZE; i++){
+    char want = i < PGSIZE ? 'A' : i < FSZ ? 'B' : 0;
+    if(p[i] != want){
+      printf("mmaptest: %s: byte %d is %d, not %d\n", why, i, p[i], want);
+      exit(1);
+    }
+  }
+}
+
+// Check that f's first n bytes are c.
+void
+checkfile(char *f, int n, char c)
+{
+  int fd, i;
+
+  if((fd = open(f, O_RDONLY)) < 0)
+    err("open");
+  if(read(fd, buf, n) != n)
+    err("read back");
+  close(fd);
+  for(i = 0; i < n; i++)
+    if(buf[i] != c){
+      printf("mmaptest: file byte %d is %d, not %d\n", i, buf[i], c);
+      exit(1);
+    }
+}
+
+void
+private_test(char *f)
+{
+  char *p;
+  int fd;
+
+  printf("private_test: ");
+  makefile(f);
+  if((fd = open(f, O_RDONLY)) < 0)
+    err("open");
+  p = mmap(0, 2*PGSIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if(p == (char*)-1)
+    err("mmap private");
+  close(fd);   // the mapping keeps the file
+  checkmap(p, "private");
+
+  // writes stay private.
+  memset(p, 'Z', 2*PGSIZE);
+  if(munmap(p, 2*PGSIZE) < 0)
+    err("munmap");
+  checkfile(f, PGSIZE, 'A');
+
+  // the mapping is gone.
+  if(fork() == 0){
+    p[0] = 1;
+    exit(0);
+  }
+  int xstatus;
+  wait(&xstatus);
+  if(xstatus != -1)
+    err("access after munmap");
+  printf("OK\n");
+}
+
+void
+shared_test(char *f)
+{
+  char *p;
+  int fd;
+
+  printf("shared_test: ");
+  makefile(f);
+  if((fd = open(f, O_RDONLY)) < 0)
+    err("open");
+  if(mmap(0, PGSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) != (char*)-1)
+    err("rejecting a writable shared map of a read-only file");
+  close(fd);
+
+  if((fd = open(f, O_RDWR)) < 0)
+    err("open");
+  p = mmap(0, 2*PGSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == (char*)-1)
+    err("mmap shared");
+  checkmap(p, "shared");
+  memset(p, 'C', PGSIZE);
+  memset(p + PGSIZE, 'D', PGSIZE);
+
+  // unmap one page at a time; each goes back to the file.
+  if(munmap(p, PGSIZE) < 0)
+    err("munmap first page");
+  checkfile(f, PGSIZE, 'C');
+  if(munmap(p + PGSIZE, PGSIZE) < 0)
+    err("munmap second page");
+  if(read(fd, buf, FSZ) != FSZ)   // the file did not grow
+    err("read");
+  if(read(fd, buf, 1) != 0)
+    err("file grew");
+  close(fd);
+  if((fd = open(f, O_RDONLY)) < 0 || read(fd, buf, FSZ) != FSZ)
+    err("reopen");
+  close(fd);
+  if(buf[PGSIZE] != 'D' || buf[FSZ-1] != 'D')
+    err("write back of the partial page");
+  printf("OK\n");
+}
+
+void
+fork_test(char *f)
+{
+  char *p, *q;
+  int fd, xstatus;
+
+  printf("fork_test: ");
+  makefile(f);
+  if((fd = open(f, O_RDWR)) < 0)
+    err("open");
+  p = mmap(0, 2*PGSIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+  q = mmap(0, 2*PGSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == (char*)-1 || q == (char*)-1 || p == q)
+    err("mmap");
+  close(fd);
+  q[0] = 'E';    // fault in the first page before forking
+
+  if(fork() == 0){
+    // neither mapping has been touched here except q[0].
+    checkmap(p, "child private");
+    if(q[0] != 'E')
+      err("child sees the parent's shared write");
+    q[1] = 'F';
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(1);
+  if(q[1] != 'F')
+    err("parent sees the child's shared write");
+  if(munmap(p, 2*PGSIZE) < 0 || munmap(q, 2*PGSIZE) < 0)
+    err("munmap");
+  printf("OK\n");
+}
+
+void
+syscall_test(char *f)
+{
+  char *p;
+  int fd;
+
+  printf("syscall_test: ");
+  makefile(f);
+  if((fd = open(f, O_RDWR)) < 0)
+    err("open");
+  p = mmap(0, 3*PGSIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if(p == (char*)-1)
+    err("mmap");
+
+  // read() into, and write() from, pages not yet touched.
+  if(read(fd, p + 2*PGSIZE, 10) != 10)
+    err("read into mapping");
+  if(p[2*PGSIZE] != 'A' || p[2*PGSIZE+9] != 'A')
+    err("read into mapping");
+  close(fd);
+  if((fd = open("mmap.out", O_WRONLY | O_CREATE)) < 0)
+    err("open");
+  if(write(fd, p, FSZ) != FSZ)
+    err("write from mapping");
+  close(fd);
+  checkfile("mmap.out", PGSIZE, 'A');
+  unlink("mmap.out");
+
+  // punch a hole in the middle.
+  if(munmap(p + PGSIZE, PGSIZE) < 0)
+    err("munmap middle");
+  if(p[0] != 'A' || p[2*PGSIZE] != 'A')
+    err("pages around the hole");
+  if(munmap(p, PGSIZE) < 0 || munmap(p + 2*PGSIZE, PGSIZE) < 0)
+    err("munmap ends");
+  printf("OK\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  private_test("mmap.tmp");
+  shared_test("mmap.tmp");
+  fork_test("mmap.tmp");
+  syscall_test("mmap.tmp");
+  unlink("mmap.tmp");
+  printf("mmaptest: all tests succeeded\n");
+  exit(0);
+}
@@ -0,0 +1,53 @@
+// Run a command and report the cycles and instructions it and
+// its children took, in total and in user space:
+//   perf cmd [args...]
+
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/perfinfo.h"
+#include "user/user.h"
+
+// Print instret / cycles to two places.
+void
+ipc(char *what, uint64 cycles, uint64 instret)
+{
+  uint64 x;
+
+  x = cycles ? instret * 100 / cycles : 0;
+  printf("%s\t%l cycles\t%l instructions\tIPC %l.%l%l\n", what,
+         cycles, instret, x / 100, x / 10 % 10, x % 10);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct perfinfo before, after;
+  int pid, xstatus;
+
+  if(argc < 2){
+    fprintf(2, "usage: perf cmd [args...]\n");
+    exit(1);
+  }
+
+  if(perfinfo(0, &before) < 0){
+    fprintf(2, "perf: perfinfo failed\n");
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "perf: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "perf: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(&xstatus);
+  perfinfo(0, &after);
+
+  ipc("total", after.ccycles - before.ccycles, after.cinstret - before.cinstret);
+  ipc("user", after.cucycles - before.cucycles, after.cuinstret - before.cuinstret);
+  exit(xstatus);
+}
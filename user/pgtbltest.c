@@ -2,16 +2,19 @@
 #include "kernel/fcntl.h"
 #include "kernel/types.h"
 #include "kernel/riscv.h"
+#include "kernel/wsinfo.h"
 #include "user/user.h"
 
 void ugetpid_test();
 void pgaccess_test();
+void wsinfo_test();
 
 int
 main(int argc, char *argv[])
 {
   ugetpid_test();
   pgaccess_test();
+  wsinfo_test();
   printf("pgtbltest: all tests succeeded\n");
   exit(0);
 }
@@ -68,3 +71,28 @@ pgaccess_test()
   free(buf);
   printf("pgaccess_test: OK\n");
 }
+
+void
+wsinfo_test()
+{
+  struct wsinfo ws;
+  char *buf;
+  int i, t0;
+
+  printf("wsinfo_test starting\n");
+  testname = "wsinfo_test";
+  buf = malloc(64 * PGSIZE);
+  // keep touching the pages over several sampling intervals.
+  t0 = uptime();
+  while(uptime() - t0 < 30)
+    for(i = 0; i < 64; i++)
+      buf[i * PGSIZE] += 1;
+  if(wsinfo(0, &ws) < 0)
+    err("wsinfo failed");
+  if(ws.ticks == 0 || ws.touched < 64 || ws.resident < ws.touched)
+    err("implausible working set");
+  if(wsinfo(getpid() + 1000, &ws) >= 0)
+    err("wsinfo of a missing process");
+  free(buf);
+  printf("wsinfo_test: OK\n");
+}
@@ -1,19 +1,83 @@
+//
+// Formatted output, and buffered input and output.
+//
+// By default each printf() collects its output and writes it
+// with one write(), rather than one per character. setvbuf()
+// makes printf() to a descriptor go through a buffer instead,
+// written when it fills (_IOFBF), or also at each newline
+// (_IOLBF); fflush() and exit() write out what it holds. As
+// in C, a process should fflush() buffered output before
+// fork() or exec(), and the buffers are not for use by
+// several threads at once.
+//
+// fgets() reads a byte at a time, so that it takes no more
+// than the line from the descriptor, and a child that inherits
+// it (say, one run by sh from a script on its standard input)
+// reads on from there. setvbuf() with a buffered mode makes it
+// read ahead through a buffer instead, which such a child will
+// not see.
+//
+
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/param.h"
 #include "user/user.h"
 
 #include <stdarg.h>
 
+#define BUFSIZ 512    // bytes in a descriptor's buffer
+#define CALLSIZ 128   // bytes collected on the stack per call
+
+// An output buffer.
+struct obuf {
+  int fd;
+  int mode;     // _IONBF, _IOLBF, or _IOFBF
+  int n;        // bytes in buf
+  int size;
+  char *buf;
+};
+
+// An input buffer.
+struct ibuf {
+  int r;        // next to return
+  int n;        // bytes in buf
+  char *buf;
+};
+
+static struct obuf obufs[NOFILE];
+static struct ibuf ibufs[NOFILE];
+
+extern void (*exitflush)(void);   // ulib.c
+
 static char digits[] = "0123456789ABCDEF";
 
 static void
-putc(int fd, char c)
+flushbuf(struct obuf *b)
+{
+  if(b->n > 0)
+    write(b->fd, b->buf, b->n);
+  b->n = 0;
+}
+
+static void
+flushall(void)
+{
+  int fd;
+
+  for(fd = 0; fd < NOFILE; fd++)
+    flushbuf(&obufs[fd]);
+}
+
+static void
+putc(struct obuf *b, char c)
 {
-  write(fd, &c, 1);
+  b->buf[b->n++] = c;
+  if(b->n == b->size || (c == '\n' && b->mode == _IOLBF))
+    flushbuf(b);
 }
 
 static void
-printint(int fd, int xx, int base, int sgn)
+printint(struct obuf *b, int xx, int base, int sgn)
 {
   char buf[16];
   int i, neg;
@@ -35,24 +99,52 @@ printint(int fd, int xx, int base, int sgn)
     buf[i++] = '-';
 
   while(--i >= 0)
-    putc(fd, buf[i]);
+    putc(b, buf[i]);
 }
 
+// print an unsigned 64-bit value, for %l.
 static void
-printptr(int fd, uint64 x) {
+printlong(struct obuf *b, uint64 x, int base)
+{
+  char buf[24];
   int i;
-  putc(fd, '0');
-  putc(fd, 'x');
+
+  i = 0;
+  do{
+    buf[i++] = digits[x % base];
+  }while((x /= base) != 0);
+
+  while(--i >= 0)
+    putc(b, buf[i]);
+}
+
+static void
+printptr(struct obuf *b, uint64 x) {
+  int i;
+  putc(b, '0');
+  putc(b, 'x');
   for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)
-    putc(fd, digits[x >> (sizeof(uint64) * 8 - 4)]);
+    putc(b, digits[x >> (sizeof(uint64) * 8 - 4)]);
 }
 
 // Print to the given fd. Only understands %d, %x, %p, %s.
 void
 vprintf(int fd, const char *fmt, va_list ap)
 {
-  char *s;
+  char *s, sbuf[CALLSIZ];
   int c, i, state;
+  struct obuf tmp, *b;
+
+  if(fd >= 0 && fd < NOFILE && obufs[fd].mode != _IONBF){
+    b = &obufs[fd];
+  } else {
+    b = &tmp;
+    b->fd = fd;
+    b->mode = _IONBF;
+    b->n = 0;
+    b->size = sizeof(sbuf);
+    b->buf = sbuf;
+  }
 
   state = 0;
   for(i = 0; fmt[i]; i++){
@@ -61,37 +153,39 @@ vprintf(int fd, const char *fmt, va_list ap)
       if(c == '%'){
         state = '%';
       } else {
-        putc(fd, c);
+        putc(b, c);
       }
     } else if(state == '%'){
       if(c == 'd'){
-        printint(fd, va_arg(ap, int), 10, 1);
+        printint(b, va_arg(ap, int), 10, 1);
       } else if(c == 'l') {
-        printint(fd, va_arg(ap, uint64), 10, 0);
+        printlong(b, va_arg(ap, uint64), 10);
       } else if(c == 'x') {
-        printint(fd, va_arg(ap, int), 16, 0);
+        printint(b, va_arg(ap, int), 16, 0);
       } else if(c == 'p') {
-        printptr(fd, va_arg(ap, uint64));
+        printptr(b, va_arg(ap, uint64));
       } else if(c == 's'){
         s = va_arg(ap, char*);
         if(s == 0)
           s = "(null)";
         while(*s != 0){
-          putc(fd, *s);
+          putc(b, *s);
           s++;
         }
       } else if(c == 'c'){
-        putc(fd, va_arg(ap, uint));
+        putc(b, va_arg(ap, uint));
       } else if(c == '%'){
-        putc(fd, c);
+        putc(b, c);
       } else {
         // Unknown % sequence.  Print it to draw attention.
-        putc(fd, '%');
-        putc(fd, c);
+        putc(b, '%');
+        putc(b, c);
       }
       state = 0;
     }
   }
+  if(b->mode == _IONBF)
+    flushbuf(b);
 }
 
 void
@@ -111,3 +205,81 @@ printf(const char *fmt, ...)
   va_start(ap, fmt);
   vprintf(1, fmt, ap);
 }
+
+// Set how printf() to fd, and fgets() from it, are buffered:
+// _IONBF, _IOLBF, or _IOFBF. Returns 0, or -1 if fd or mode is bad or there is
+// no memory for a buffer.
+int
+setvbuf(int fd, int mode)
+{
+  struct obuf *b;
+
+  if(fd < 0 || fd >= NOFILE || mode < _IONBF || mode > _IOFBF)
+    return -1;
+  b = &obufs[fd];
+  flushbuf(b);
+  if(mode != _IONBF && b->buf == 0 && (b->buf = malloc(BUFSIZ)) == 0)
+    return -1;
+  b->fd = fd;
+  b->mode = mode;
+  b->size = BUFSIZ;
+  exitflush = flushall;
+  return 0;
+}
+
+// Write out what fd's buffer holds.
+int
+fflush(int fd)
+{
+  if(fd < 0 || fd >= NOFILE)
+    return -1;
+  flushbuf(&obufs[fd]);
+  return 0;
+}
+
+// Read a line of at most max-1 bytes from fd into buf.
+char*
+fgets(int fd, char *buf, int max)
+{
+  struct ibuf *b;
+  int i;
+  char c;
+
+  buf[0] = '\0';
+  if(fd < 0 || fd >= NOFILE)
+    return buf;
+  b = &ibufs[fd];
+
+  for(i=0; i+1 < max; ){
+    if(b->r < b->n){
+      c = b->buf[b->r++];
+    } else {
+      // let a prompt out before waiting for input.
+      flushall();
+      if(obufs[fd].mode == _IONBF){
+        if(read(fd, &c, 1) < 1)
+          break;
+      } else {
+        if(b->buf == 0 && (b->buf = malloc(BUFSIZ)) == 0)
+          break;
+        b->r = 0;
+        if((b->n = read(fd, b->buf, BUFSIZ)) < 1){
+          b->n = 0;
+          break;
+        }
+        c = b->buf[b->r++];
+      }
+    }
+    buf[i++] = c;
+    if(c == '\n' || c == '\r')
+      break;
+  }
+  buf[i] = '\0';
+  return buf;
+}
+
+char*
+gets(char *buf, int max)
+{
+  return fgets(0, buf, max);
+}
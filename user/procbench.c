@@ -0,0 +1,65 @@
+// Time fork(), exit() and wait() while more and more other
+// processes exist: idle children blocked reading a pipe. The
+// time per round should not grow with their number.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NROUND 500
+
+int
+main(int argc, char *argv[])
+{
+  int fds[2], nidle, step, i, pid, t0, xstatus;
+  char c;
+
+  if(pipe(fds) < 0){
+    printf("procbench: pipe failed\n");
+    exit(1);
+  }
+  // leave room for the shell, this process and a child.
+  step = (NPROC - 8) / 4;
+  printf("ticks for %d rounds of fork, exit and wait\n", NROUND);
+  for(nidle = 0; ; ){
+    t0 = uptime();
+    for(i = 0; i < NROUND; i++){
+      if((pid = fork()) < 0){
+        printf("procbench: fork failed\n");
+        exit(1);
+      }
+      if(pid == 0)
+        exit(0);
+      if(wait(&xstatus) != pid || xstatus != 0){
+        printf("procbench: wait failed\n");
+        exit(1);
+      }
+    }
+    printf("%d idle processes: %d ticks\n", nidle, uptime() - t0);
+    if(nidle + step > NPROC - 8)
+      break;
+    for(i = 0; i < step; i++, nidle++){
+      if((pid = fork()) < 0){
+        printf("procbench: fork failed\n");
+        exit(1);
+      }
+      if(pid == 0){
+        close(fds[1]);
+        read(fds[0], &c, 1);
+        exit(0);
+      }
+    }
+  }
+
+  // wrong pids cost as much as right ones to look up.
+  t0 = uptime();
+  for(i = 0; i < NROUND; i++)
+    kill(1000000 + i);
+  printf("%d kills of no process: %d ticks\n", NROUND, uptime() - t0);
+
+  close(fds[1]);
+  while(wait(0) >= 0)
+    ;
+  exit(0);
+}
@@ -0,0 +1,201 @@
+// Profile a command: prof [-r rate] cmd [args...]
+//
+// Samples the pc rate times per clock tick while cmd runs,
+// then prints a flat profile of the samples taken in cmd and
+// the processes it started, by function: kernel addresses
+// looked up in kernel.sym, user ones in cmd's .sym file.
+// Samples of other processes are only counted, as "other".
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "kernel/prof.h"
+#include "user/user.h"
+
+#define MAXSAMPLE (NCPU * NPROFSAMPLE)
+#define NSHOW 20
+
+struct symtab {
+  int n;
+  uint64 *addr;
+  char **name;
+  int *count;
+};
+
+struct profsample samples[MAXSAMPLE];
+struct symtab ksyms, usyms;
+
+// Is s the name of a source or object file?
+int
+source(char *s)
+{
+  int n = strlen(s);
+
+  return n > 2 && s[n-2] == '.' && strchr("cSo", s[n-1]) != 0;
+}
+
+// Load the symbols in file, lines of "address name" as the
+// Makefile writes them. Leaves t empty if there is no file.
+void
+loadsyms(char *file, struct symtab *t)
+{
+  struct stat st;
+  char *buf, *s, *e;
+  uint64 a;
+  int fd, n;
+
+  t->n = 0;
+  if((fd = open(file, O_RDONLY)) < 0)
+    return;
+  if(fstat(fd, &st) < 0 || (buf = malloc(st.size + 1)) == 0){
+    close(fd);
+    return;
+  }
+  n = read(fd, buf, st.size);
+  close(fd);
+  if(n < 0)
+    n = 0;
+  buf[n] = 0;
+
+  for(s = buf, n = 0; *s; s++)
+    n += *s == '\n';
+  t->addr = malloc(n * sizeof(uint64));
+  t->name = malloc(n * sizeof(char*));
+  t->count = malloc(n * sizeof(int));
+  for(s = buf; *s; s = e + 1){
+    for(e = s; *e && *e != '\n'; e++)
+      ;
+    if(*e == 0)
+      break;
+    *e = 0;
+    for(a = 0; (*s >= '0' && *s <= '9') || (*s >= 'a' && *s <= 'f'); s++)
+      a = a*16 + (*s <= '9' ? *s - '0' : *s - 'a' + 10);
+    if(*s++ != ' ' || *s == '.' || strchr(s, '/') || source(s))
+      continue;   // sections, local labels and files
+    t->addr[t->n] = a;
+    t->name[t->n] = s;
+    t->count[t->n] = 0;
+    t->n++;
+  }
+}
+
+// Count a sample at pc against the symbol at or below it.
+// Returns 0 if there is none.
+int
+count(struct symtab *t, uint64 pc)
+{
+  int i, best = -1;
+
+  for(i = 0; i < t->n; i++)
+    if(t->addr[i] <= pc && (best < 0 || t->addr[i] > t->addr[best]))
+      best = i;
+  if(best < 0)
+    return 0;
+  t->count[best]++;
+  return 1;
+}
+
+// Print the symbols of t and u with the most samples.
+void
+report(struct symtab *t, struct symtab *u, int total)
+{
+  struct symtab *bt;
+  int i, k, shown, bi, bc;
+
+  for(shown = 0; shown < NSHOW; shown++){
+    bt = 0;
+    bi = bc = 0;
+    for(k = 0; k < 2; k++){
+      struct symtab *s = k == 0 ? t : u;
+      for(i = 0; i < s->n; i++){
+        if(s->count[i] > bc){
+          bt = s;
+          bi = i;
+          bc = s->count[i];
+        }
+      }
+    }
+    if(bt == 0)
+      break;
+    printf("%d\t%d%%\t%s %s\n", bc, bc * 100 / total, bt == t ? "[k]" : "[u]", bt->name[bi]);
+    bt->count[bi] = 0;
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  char symfile[DIRSIZ+8], *cmd;
+  int i, n, fd, rate, pid, self, total, idle, inprof, other, unknown;
+
+  rate = 10;
+  i = 1;
+  if(argc > 2 && strcmp(argv[1], "-r") == 0){
+    rate = atoi(argv[2]);
+    i = 3;
+  }
+  if(i >= argc){
+    fprintf(2, "usage: prof [-r rate] cmd [args...]\n");
+    exit(1);
+  }
+  cmd = argv[i];
+
+  if((fd = open("profile", O_RDONLY)) < 0){
+    fprintf(2, "prof: cannot open profile\n");
+    exit(1);
+  }
+  if(profile(rate) < 0){
+    fprintf(2, "prof: bad rate %d\n", rate);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "prof: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(fd);
+    exec(argv[i], argv + i);
+    fprintf(2, "prof: exec %s failed\n", argv[i]);
+    exit(1);
+  }
+  wait(0);
+  profile(0);
+
+  n = 0;
+  while(n < MAXSAMPLE &&
+        (i = read(fd, &samples[n], (MAXSAMPLE - n) * sizeof(samples[0]))) > 0)
+    n += i / sizeof(samples[0]);
+  close(fd);
+
+  loadsyms("kernel.sym", &ksyms);
+  if(strlen(cmd) > DIRSIZ)
+    cmd[DIRSIZ] = 0;
+  strcpy(symfile, cmd);
+  strcpy(symfile + strlen(symfile), ".sym");
+  loadsyms(symfile, &usyms);
+
+  self = getpid();
+  total = idle = inprof = other = unknown = 0;
+  for(i = 0; i < n; i++){
+    if(samples[i].pid == 0)
+      idle++;
+    else if(samples[i].pid == self)
+      inprof++;
+    else if((samples[i].flags & PS_TREE) == 0)
+      other++;
+    else if(count(samples[i].flags & PS_USER ? &usyms : &ksyms, samples[i].pc))
+      total++;
+    else
+      unknown++;
+  }
+  printf("%d samples: %d in %s, %d unknown, %d idle, %d in prof, %d other\n",
+         n, total, cmd, unknown, idle, inprof, other);
+  if(usyms.n == 0)
+    printf("(no %s; user samples are unknown)\n", symfile);
+  if(total > 0)
+    report(&ksyms, &usyms, total);
+  exit(0);
+}
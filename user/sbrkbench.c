@@ -0,0 +1,51 @@
+// Time large sbrk() growth and shrink, which exercise
+// uvmalloc()/uvmdealloc() and the copy of the new mappings
+// into the process's kernel page table.
+//
+//   sbrkbench [megabytes [rounds]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  int mb = 32, rounds = 20;
+  int i, t0, tgrow = 0, tshrink = 0;
+  char *a;
+
+  if(argc > 1)
+    mb = atoi(argv[1]);
+  if(argc > 2)
+    rounds = atoi(argv[2]);
+  if(mb <= 0 || rounds <= 0){
+    fprintf(2, "usage: sbrkbench [megabytes [rounds]]\n");
+    exit(1);
+  }
+
+  for(i = 0; i < rounds; i++){
+    t0 = uptime();
+    a = sbrk(mb * 1024 * 1024);
+    if(a == (char*)-1){
+      fprintf(2, "sbrkbench: sbrk(%d MB) failed\n", mb);
+      exit(1);
+    }
+    tgrow += uptime() - t0;
+
+    // touch both ends of the new region.
+    a[0] = 1;
+    a[mb * 1024 * 1024 - 1] = 1;
+
+    t0 = uptime();
+    if(sbrk(-(mb * 1024 * 1024)) == (char*)-1){
+      fprintf(2, "sbrkbench: shrink failed\n");
+      exit(1);
+    }
+    tshrink += uptime() - t0;
+  }
+
+  printf("sbrkbench: %d x %d MB: grow %d ticks, shrink %d ticks\n",
+         rounds, mb, tgrow, tshrink);
+  exit(0);
+}
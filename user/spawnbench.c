@@ -0,0 +1,61 @@
+// Compare the time to start a program with fork() and exec()
+// against spawn(), as the caller's memory grows.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define N 100
+
+char *args[] = { "spawnbench", "-exit", 0 };
+
+// Ticks to start and wait for N copies of this program,
+// which exit at once, by fork() and exec() or by spawn().
+int
+run(int usespawn)
+{
+  int i, t0, pid;
+
+  t0 = uptime();
+  for(i = 0; i < N; i++){
+    if(usespawn){
+      pid = spawn(args[0], args, 0);
+    } else if((pid = fork()) == 0){
+      exec(args[0], args);
+      exit(1);
+    }
+    if(pid < 0){
+      printf("spawnbench: %s failed\n", usespawn ? "spawn" : "fork");
+      exit(1);
+    }
+    wait(0);
+  }
+  return uptime() - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mb, grown, i, n;
+  char *p;
+
+  if(argc > 1 && strcmp(argv[1], "-exit") == 0)
+    exit(0);
+
+  printf("spawnbench: ticks for %d starts\n", N);
+  grown = 0;
+  for(mb = 0; mb <= 16; mb = mb ? 2*mb : 1){
+    // grow by mb MB in all, touching every page so that
+    // fork() has it all to copy.
+    n = (mb - grown) * 1024 * 1024;
+    if((p = sbrk(n)) == (char*)-1){
+      printf("spawnbench: sbrk failed\n");
+      exit(1);
+    }
+    for(i = 0; i < n; i += 4096)
+      p[i] = 1;
+    grown = mb;
+    printf("+%d MB: fork+exec %d, spawn %d\n", mb, run(0), run(1));
+  }
+  exit(0);
+}
@@ -0,0 +1,19 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define SZ 4096
+char buf[SZ];
+
+// Print the kernel's statistics.
+int
+main(void)
+{
+  int n;
+
+  n = statistics(buf, SZ);
+  if(n < 0)
+    exit(1);
+  write(1, buf, n);
+  exit(0);
+}
@@ -0,0 +1,33 @@
+// Run a command, printing the system calls it and its
+// children make whose bits are set in mask:
+//   strace mask cmd [args...]
+
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  int i;
+  char *nargv[MAXARG];
+
+  if(argc < 3 || (argv[1][0] < '0' || argv[1][0] > '9')){
+    fprintf(2, "usage: strace mask cmd [args...]\n");
+    exit(1);
+  }
+
+  if(trace(atoi(argv[1])) < 0){
+    fprintf(2, "strace: trace failed\n");
+    exit(1);
+  }
+
+  for(i = 2; i < argc && i < MAXARG; i++){
+    nargv[i-2] = argv[i];
+  }
+  nargv[i-2] = 0;
+  exec(nargv[0], nargv);
+  fprintf(2, "strace: exec %s failed\n", nargv[0]);
+  exit(1);
+}
@@ -0,0 +1,102 @@
+// Test swapping: grow past the free physical memory, check
+// that every page kept its contents, in this process and in
+// a forked child, and that pages were swapped out and in.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+#define EXTRA  (8*1024*1024)   // bytes beyond free memory
+#define SMALL  (4*1024*1024)   // bytes kept for the fork
+
+char buf[4096];
+
+// Read the statistics into buf and return the number after
+// the first occurrence of key on the line starting with line,
+// or -1.
+int
+readstat(char *line, char *key)
+{
+  char *s;
+  int n, len = strlen(key);
+
+  n = statistics(buf, sizeof(buf) - 1);
+  if(n <= 0)
+    return -1;
+  buf[n] = 0;
+  for(s = buf; *s; s++)
+    if((s == buf || s[-1] == '\n') && memcmp(s, line, strlen(line)) == 0)
+      break;
+  for(; *s && *s != '\n'; s++)
+    if(memcmp(s, key, len) == 0)
+      return atoi(s + len);
+  return -1;
+}
+
+// Check that each page of [p, p+n) holds its own index.
+void
+check(char *p, int n, char *who)
+{
+  int i;
+
+  for(i = 0; i < n; i += PGSIZE){
+    if(*(int*)(p + i) != i / PGSIZE){
+      printf("swaptest: %s: page %d holds %d\n", who, i / PGSIZE, *(int*)(p + i));
+      exit(1);
+    }
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int free, n, i, out, in, xstatus;
+  char *p;
+
+  free = readstat("kalloc: ", "free pages ");
+  out = readstat("swap: ", " out ");
+  in = readstat("swap: ", " in ");
+  if(free < 0 || out < 0 || in < 0){
+    printf("swaptest: cannot read statistics\n");
+    exit(1);
+  }
+
+  // grow a page at a time, so every page is an ordinary one.
+  n = free * PGSIZE + EXTRA;
+  p = sbrk(0);
+  for(i = 0; i < n; i += PGSIZE){
+    if(sbrk(PGSIZE) == (char*)-1){
+      printf("swaptest: sbrk failed after %d of %d pages\n", i / PGSIZE, n / PGSIZE);
+      exit(1);
+    }
+    *(int*)(p + i) = i / PGSIZE;
+  }
+  if(readstat("swap: ", " out ") == out){
+    printf("swaptest: nothing was swapped out\n");
+    exit(1);
+  }
+  check(p, n, "parent");
+  if(readstat("swap: ", " in ") == in){
+    printf("swaptest: nothing was swapped in\n");
+    exit(1);
+  }
+
+  // keep only the first pages, most of which are now in swap,
+  // so that fork() has room to copy the rest; the child shares
+  // the swapped-out ones.
+  if(sbrk(SMALL - n) == (char*)-1){
+    printf("swaptest: shrinking failed\n");
+    exit(1);
+  }
+  if(fork() == 0){
+    check(p, SMALL, "child");
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(1);
+  check(p, SMALL, "parent after fork");
+  printf("swaptest: OK\n");
+  exit(0);
+}
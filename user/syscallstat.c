@@ -0,0 +1,118 @@
+// Print system call counts and latencies: those since boot,
+// or, given a command, those made while it ran (by any
+// process).
+//   syscallstat [-h] [cmd [args...]]
+// -h adds each call's histogram of latencies, by power of two.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memlayout.h"
+#include "kernel/syscall.h"
+#include "kernel/scstat.h"
+#include "user/user.h"
+
+#define NSC 64
+#define CYCLESUS (TIMEBASE / 1000000)   // timer cycles per microsecond
+
+char *names[NSC] = {
+[SYS_fork]    "fork",
+[SYS_exit]    "exit",
+[SYS_wait]    "wait",
+[SYS_pipe]    "pipe",
+[SYS_read]    "read",
+[SYS_kill]    "kill",
+[SYS_exec]    "exec",
+[SYS_fstat]   "fstat",
+[SYS_chdir]   "chdir",
+[SYS_dup]     "dup",
+[SYS_getpid]  "getpid",
+[SYS_sbrk]    "sbrk",
+[SYS_sleep]   "sleep",
+[SYS_uptime]  "uptime",
+[SYS_open]    "open",
+[SYS_write]   "write",
+[SYS_mknod]   "mknod",
+[SYS_unlink]  "unlink",
+[SYS_link]    "link",
+[SYS_mkdir]   "mkdir",
+[SYS_close]   "close",
+[SYS_trace]   "trace",
+[SYS_mmap]    "mmap",
+[SYS_munmap]  "munmap",
+[SYS_connect] "connect",
+[SYS_pgaccess] "pgaccess",
+[SYS_wsinfo]  "wsinfo",
+[SYS_spawn]   "spawn",
+[SYS_clone]   "clone",
+[SYS_futex_wait] "futex_wait",
+[SYS_futex_wake] "futex_wake",
+[SYS_getprocinfo] "getprocinfo",
+[SYS_profile] "profile",
+[SYS_tracemask] "tracemask",
+[SYS_syscallstat] "syscallstat",
+[SYS_perfinfo] "perfinfo",
+};
+
+struct scstat before[NSC], after[NSC];
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, b, hist, pid;
+  struct scstat *a, *s;
+  uint64 lo;
+
+  hist = 0;
+  i = 1;
+  if(i < argc && strcmp(argv[i], "-h") == 0){
+    hist = 1;
+    i++;
+  }
+
+  if(i < argc){
+    if(syscallstat(before, NSC) < 0){
+      fprintf(2, "syscallstat: failed\n");
+      exit(1);
+    }
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "syscallstat: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(argv[i], argv + i);
+      fprintf(2, "syscallstat: exec %s failed\n", argv[i]);
+      exit(1);
+    }
+    wait(0);
+  }
+  if((n = syscallstat(after, NSC)) < 0){
+    fprintf(2, "syscallstat: failed\n");
+    exit(1);
+  }
+  if(n > NSC)
+    n = NSC;
+
+  printf("syscall\tcalls\ttotal us\tmean us\n");
+  for(i = 0; i < n; i++){
+    a = &after[i];
+    s = &before[i];
+    a->count -= s->count;
+    a->cycles -= s->cycles;
+    for(b = 0; b < NSCBUCKET; b++)
+      a->hist[b] -= s->hist[b];
+    if(a->count == 0)
+      continue;
+    printf("%s\t%l\t%l\t%l\n", names[i] ? names[i] : "?", a->count,
+           a->cycles / CYCLESUS, a->cycles / CYCLESUS / a->count);
+    if(!hist)
+      continue;
+    for(b = 0; b < NSCBUCKET; b++){
+      if(a->hist[b] == 0)
+        continue;
+      lo = b == 0 ? 0 : 1L << (b - 1);
+      printf("\t>= %l cycles\t%d\n", lo, a->hist[b]);
+    }
+  }
+  exit(0);
+}
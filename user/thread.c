@@ -0,0 +1,163 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// Threads, on top of clone(): each runs on a stack that
+// thread_create() allocates and thread_join() frees. malloc()
+// is not safe to call from two threads at once, so only one
+// thread should create and join the others.
+//
+// Mutexes and condition variables, on top of futex_wait() and
+// futex_wake(): uncontended operations make no system call.
+// They work between processes too, in MAP_SHARED memory.
+
+#define NTHREAD   64
+#define TSTACK    (4*4096)
+
+struct tstart {
+  void (*fn)(void*);
+  void *arg;
+};
+
+// A slot is in use from thread_create() until thread_join()
+// returns for its thread. wait() may reap a thread before it is
+// joined; its stack is freed then, and exited set.
+static struct {
+  int tid;         // 0 if the slot is free
+  char *stack;
+  int exited;
+} threads[NTHREAD];
+
+// The first function of every thread; s lies at the top of
+// its stack.
+static void
+tstart(void *s)
+{
+  struct tstart *ts = s;
+
+  ts->fn(ts->arg);
+  exit(0);
+}
+
+// Start a thread that calls fn(arg), then exits.
+// Returns its id, or -1.
+int
+thread_create(void (*fn)(void*), void *arg)
+{
+  struct tstart *ts;
+  char *stack;
+  int i, tid;
+
+  for(i = 0; i < NTHREAD; i++)
+    if(threads[i].tid == 0)
+      break;
+  if(i == NTHREAD || (stack = malloc(TSTACK)) == 0)
+    return -1;
+  ts = (struct tstart*)(((uint64)(stack + TSTACK) & ~15L) - 16);
+  ts->fn = fn;
+  ts->arg = arg;
+  if((tid = clone(tstart, ts, ts)) < 0){
+    free(stack);
+    return -1;
+  }
+  threads[i].tid = tid;
+  threads[i].stack = stack;
+  threads[i].exited = 0;
+  return tid;
+}
+
+// Wait for thread tid to exit and free its stack. Other
+// threads that wait() reaps meanwhile are recorded as exited,
+// so that joining them later returns at once.
+// Returns 0, or -1 if there is no such thread.
+int
+thread_join(int tid)
+{
+  int i, j, pid;
+
+  if(tid <= 0)
+    return -1;
+  for(i = 0; i < NTHREAD; i++)
+    if(threads[i].tid == tid)
+      break;
+  if(i == NTHREAD)
+    return -1;
+  while(!threads[i].exited){
+    if((pid = wait(0)) < 0)
+      return -1;
+    for(j = 0; j < NTHREAD; j++){
+      if(threads[j].tid == pid && !threads[j].exited){
+        free(threads[j].stack);
+        threads[j].stack = 0;
+        threads[j].exited = 1;
+      }
+    }
+  }
+  threads[i].tid = 0;
+  return 0;
+}
+
+void
+mutex_init(struct mutex *m)
+{
+  m->state = 0;
+}
+
+void
+mutex_lock(struct mutex *m)
+{
+  int c;
+
+  if((c = __sync_val_compare_and_swap(&m->state, 0, 1)) == 0)
+    return;
+  // contended: mark it so that mutex_unlock() wakes someone.
+  if(c != 2)
+    c = __atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE);
+  while(c != 0){
+    futex_wait(&m->state, 2);
+    c = __atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE);
+  }
+}
+
+void
+mutex_unlock(struct mutex *m)
+{
+  if(__atomic_fetch_sub(&m->state, 1, __ATOMIC_RELEASE) != 1){
+    __atomic_store_n(&m->state, 0, __ATOMIC_RELEASE);
+    futex_wake(&m->state, 1);
+  }
+}
+
+void
+cond_init(struct cond *c)
+{
+  c->seq = 0;
+}
+
+// Unlock m, wait for a signal, and lock m again. As usual,
+// the caller must check its condition again afterwards.
+void
+cond_wait(struct cond *c, struct mutex *m)
+{
+  int seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+
+  mutex_unlock(m);
+  futex_wait(&c->seq, seq);
+  // others may be waiting for m too.
+  while(__atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE) != 0)
+    futex_wait(&m->state, 2);
+}
+
+void
+cond_signal(struct cond *c)
+{
+  __atomic_fetch_add(&c->seq, 1, __ATOMIC_RELEASE);
+  futex_wake(&c->seq, 1);
+}
+
+void
+cond_broadcast(struct cond *c)
+{
+  __atomic_fetch_add(&c->seq, 1, __ATOMIC_RELEASE);
+  futex_wake(&c->seq, 0x7fffffff);
+}
@@ -0,0 +1,98 @@
+// Run a fixed amount of computation split among 1, 2, ... n
+// threads (n from the command line, default 4; try the number
+// of CPUS qemu was started with), which share the memory the
+// work and results are in.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define N      4000000
+#define BLOCK  1000    // numbers dealt to a thread at a time
+#define MAXT   16
+
+struct work {
+  int first;       // count primes in blocks first, first+step, ...
+  int step;
+  int count;
+};
+
+struct work work[MAXT];
+
+int
+isprime(int n)
+{
+  int d;
+
+  if(n < 2)
+    return 0;
+  for(d = 2; d * d <= n; d++)
+    if(n % d == 0)
+      return 0;
+  return 1;
+}
+
+void
+count(void *arg)
+{
+  struct work *w = arg;
+  int b, i;
+
+  for(b = w->first; b * BLOCK < N; b += w->step)
+    for(i = b * BLOCK; i < (b + 1) * BLOCK && i < N; i++)
+      w->count += isprime(i);
+}
+
+// Returns the number of primes below N found by nt threads,
+// setting *t to the ticks taken.
+int
+run(int nt, int *t)
+{
+  int i, total, t0, tid[MAXT];
+
+  t0 = uptime();
+  // deal out the blocks in turn, since larger numbers take
+  // longer.
+  for(i = 0; i < nt; i++){
+    work[i].first = i;
+    work[i].step = nt;
+    work[i].count = 0;
+  }
+  for(i = 0; i < nt; i++){
+    if((tid[i] = thread_create(count, &work[i])) < 0){
+      printf("threadbench: thread_create failed\n");
+      exit(1);
+    }
+  }
+  total = 0;
+  for(i = 0; i < nt; i++){
+    thread_join(tid[i]);
+    total += work[i].count;
+  }
+  *t = uptime() - t0;
+  return total;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nt, maxt, n, n1, t, t1;
+
+  maxt = argc > 1 ? atoi(argv[1]) : 4;
+  if(maxt < 1 || maxt > MAXT){
+    printf("usage: threadbench [threads <= %d]\n", MAXT);
+    exit(1);
+  }
+  n1 = run(1, &t1);
+  printf("1 thread: %d primes below %d in %d ticks\n", n1, N, t1);
+  for(nt = 2; nt <= maxt; nt++){
+    n = run(nt, &t);
+    if(n != n1){
+      printf("threadbench: %d threads found %d primes\n", nt, n);
+      exit(1);
+    }
+    printf("%d threads: %d ticks, speedup %d.%d\n", nt, t,
+           t ? t1 / t : 0, t ? (10 * t1 / t) % 10 : 0);
+  }
+  exit(0);
+}
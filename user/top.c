@@ -0,0 +1,130 @@
+// Show the processes using the most CPU time, with how the
+// CPUs spent theirs, refreshed every second: top [refreshes]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/stat.h"
+#include "kernel/procinfo.h"
+#include "user/user.h"
+
+#define INTERVAL 10        // ticks between refreshes
+#define TICKUS   100000    // microseconds per tick
+#define NSHOW    16        // processes shown
+
+struct procinfo pi[2][NPROC];
+int npi[2];
+uint64 used[NPROC];        // this interval's CPU time of pi[cur][i]
+int order[NPROC];
+char buf[4096];
+
+char *states[] = { "unused", "used", "sleep", "runble", "run", "zombie" };
+
+// Print s, then pad it with spaces to w characters.
+void
+col(char *s, int w)
+{
+  int n;
+
+  printf("%s", s);
+  for(n = strlen(s); n < w; n++)
+    printf(" ");
+}
+
+// Print n right-aligned in w characters, then a space.
+void
+num(uint64 n, int w)
+{
+  char s[24];
+  int i;
+
+  i = sizeof(s) - 1;
+  s[i] = 0;
+  do {
+    s[--i] = '0' + n % 10;
+    n /= 10;
+  } while(n > 0);
+  while(i > sizeof(s) - 1 - w)
+    s[--i] = ' ';
+  printf("%s ", s + i);
+}
+
+// Print the statistics lines about CPUs.
+void
+cpulines(void)
+{
+  char *s, *e;
+  int n;
+
+  if((n = statistics(buf, sizeof(buf) - 1)) <= 0)
+    return;
+  buf[n] = 0;
+  for(s = buf; *s; s = e){
+    for(e = s; *e && *e != '\n'; e++)
+      ;
+    if(*e)
+      e++;
+    if(memcmp(s, "cpu", 3) == 0)
+      write(1, s, e - s);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int cur, nref, r, i, j, t, t0, wall;
+  struct procinfo *p, *q;
+
+  nref = argc > 1 ? atoi(argv[1]) : 10;
+  cur = 0;
+  npi[cur] = getprocinfo(pi[cur], NPROC);
+  t0 = uptime();
+  for(r = 0; r < nref; r++){
+    sleep(INTERVAL);
+    cur = !cur;
+    if((npi[cur] = getprocinfo(pi[cur], NPROC)) < 0){
+      printf("top: getprocinfo failed\n");
+      exit(1);
+    }
+    t = uptime();
+    wall = (t - t0) * TICKUS;
+    t0 = t;
+    if(wall == 0)
+      wall = 1;
+
+    // each process's time since the last refresh, biggest first.
+    for(i = 0; i < npi[cur]; i++){
+      p = &pi[cur][i];
+      used[i] = p->utime + p->stime;
+      for(j = 0; j < npi[!cur]; j++){
+        q = &pi[!cur][j];
+        if(q->pid == p->pid){
+          used[i] -= q->utime + q->stime;
+          break;
+        }
+      }
+      for(j = i; j > 0 && used[order[j-1]] < used[i]; j--)
+        order[j] = order[j-1];
+      order[j] = i;
+    }
+
+    printf("\033[2J\033[H");
+    cpulines();
+    printf("\n  PID  PPID STATE  CPU  %%CPU  USER(ms)   SYS(ms)  VCSW IVCSW FAULTS SYSCALLS NAME\n");
+    for(i = 0; i < npi[cur] && i < NSHOW; i++){
+      p = &pi[cur][order[i]];
+      num(p->pid, 5);
+      num(p->ppid, 5);
+      col(p->state < 6 ? states[p->state] : "?", 7);
+      num(p->cpu, 3);
+      num(used[order[i]] * 100 / wall, 5);
+      num(p->utime / 1000, 9);
+      num(p->stime / 1000, 9);
+      num(p->nvcsw, 5);
+      num(p->nivcsw, 5);
+      num(p->nfault, 6);
+      num(p->nsyscall, 8);
+      printf("%s\n", p->name);
+    }
+  }
+  exit(0);
+}
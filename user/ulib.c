@@ -8,6 +8,18 @@
 #include "user/user.h"
 
 
+// set by setvbuf() in printf.c, so that exit() writes out
+// buffered output.
+void (*exitflush)(void);
+
+int
+exit(int status)
+{
+  if(exitflush)
+    exitflush();
+  _exit(status);
+}
+
 //
 // wrapper so that it's OK if main() does not call exit().
 //
@@ -68,24 +80,6 @@ strchr(const char *s, char c)
   return 0;
 }
 
-char*
-gets(char *buf, int max)
-{
-  int i, cc;
-  char c;
-
-  for(i=0; i+1 < max; ){
-    cc = read(0, &c, 1);
-    if(cc < 1)
-      break;
-    buf[i++] = c;
-    if(c == '\n' || c == '\r')
-      break;
-  }
-  buf[i] = '\0';
-  return buf;
-}
-
 int
 stat(const char *n, struct stat *st)
 {
@@ -158,4 +152,29 @@ ugetpid(void)
   struct usyscall *u = (struct usyscall *)USYSCALL;
   return u->pid;
 }
+
+// Like uptime(), without a system call.
+int
+uuptime(void)
+{
+  struct usyscall *u = (struct usyscall *)USYSCALL;
+  return u->ticks;
+}
+
+// The CPU the process was on when it last entered user space.
+int
+ugetcpu(void)
+{
+  struct usyscall *u = (struct usyscall *)USYSCALL;
+  return u->cpu;
+}
+
+// Microseconds the process has spent running, as of when it
+// last entered user space.
+uint64
+uruntime(void)
+{
+  struct usyscall *u = (struct usyscall *)USYSCALL;
+  return u->runtime / (u->timebase / 1000000);
+}
 #endif
@@ -1,8 +1,13 @@
 struct stat;
+struct wsinfo;
+struct procinfo;
+struct scstat;
+struct perfinfo;
 
 // system calls
 int fork(void);
 int exit(int) __attribute__((noreturn));
+int _exit(int) __attribute__((noreturn));
 int wait(int*);
 int pipe(int*);
 int write(int, const void*, int);
@@ -10,6 +15,10 @@ int read(int, void*, int);
 int close(int);
 int kill(int);
 int exec(const char*, char**);
+int spawn(const char*, char**, int*);
+int clone(void (*)(void*), void*, void*);
+int futex_wait(int*, int);
+int futex_wake(int*, int);
 int open(const char*, int);
 int mknod(const char*, short, short);
 int unlink(const char*);
@@ -22,6 +31,15 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+void *mmap(void*, uint, int, int, int, int);
+int munmap(void*, uint);
+int wsinfo(int, struct wsinfo*);
+int getprocinfo(struct procinfo*, int);
+int profile(int);
+int tracemask(int);
+int trace(uint64);
+int syscallstat(struct scstat*, int);
+int perfinfo(int, struct perfinfo*);
 #ifdef LAB_NET
 int connect(uint32, uint16, uint16);
 #endif
@@ -29,6 +47,9 @@ int connect(uint32, uint16, uint16);
 int pgaccess(void *base, int len, void *mask);
 // usyscall region
 int ugetpid(void);
+int uuptime(void);
+int ugetcpu(void);
+uint64 uruntime(void);
 #endif
 
 // ulib.c
@@ -40,6 +61,9 @@ int strcmp(const char*, const char*);
 void fprintf(int, const char*, ...);
 void printf(const char*, ...);
 char* gets(char*, int max);
+char* fgets(int, char*, int max);
+int setvbuf(int, int);
+int fflush(int);
 uint strlen(const char*);
 void* memset(void*, int, uint);
 void* malloc(uint);
@@ -48,3 +72,25 @@ int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
 int statistics(void*, int);
+
+// setvbuf() modes
+#define _IONBF 0   // each printf() written at once
+#define _IOLBF 1   // written at each newline, or when full
+#define _IOFBF 2   // written when full
+
+// thread.c
+struct mutex {
+  int state;       // 0: unlocked; 1: locked; 2: locked, may have waiters
+};
+struct cond {
+  int seq;         // bumped by every signal
+};
+int thread_create(void (*)(void*), void*);
+int thread_join(int);
+void mutex_init(struct mutex*);
+void mutex_lock(struct mutex*);
+void mutex_unlock(struct mutex*);
+void cond_init(struct cond*);
+void cond_wait(struct cond*, struct mutex*);
+void cond_signal(struct cond*);
+void cond_broadcast(struct cond*);
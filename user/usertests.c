@@ -7,6 +7,9 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/procinfo.h"
+#include "kernel/scstat.h"
+#include "kernel/perfinfo.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -729,6 +732,427 @@ exectest(char *s)
 
 }
 
+// spawn() a program with its output going to a pipe; it must
+// not inherit the caller's other descriptors, so the reader
+// sees end of file.
+void
+spawntest(char *s)
+{
+  int p[2], fds[3], pid, xstatus, n, cc;
+  char *echoargv[] = { "echo", "OK", 0 };
+  char buf[8];
+
+  if(pipe(p) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  fds[0] = -1;
+  fds[1] = p[1];
+  fds[2] = 2;
+  if((pid = spawn("echo", echoargv, fds)) < 0){
+    printf("%s: spawn echo failed\n", s);
+    exit(1);
+  }
+  close(p[1]);
+  // a read of 0 means echo has exited and no one else holds
+  // the write end.
+  for(n = 0; n < sizeof(buf) && (cc = read(p[0], buf + n, sizeof(buf) - n)) > 0; n += cc)
+    ;
+  if(n != 3 || buf[0] != 'O' || buf[1] != 'K'){
+    printf("%s: wrong output\n", s);
+    exit(1);
+  }
+  close(p[0]);
+  if(wait(&xstatus) != pid || xstatus != 0){
+    printf("%s: wait failed\n", s);
+    exit(1);
+  }
+  if(spawn("nonexistent", echoargv, 0) >= 0){
+    printf("%s: spawn of a missing program succeeded\n", s);
+    exit(1);
+  }
+}
+
+// memory that one thread allocates and writes must be seen by
+// another.
+char *clonemem;
+int clonepid;
+
+void
+cloneworker(void *arg)
+{
+  int i;
+
+  clonepid = getpid();
+  if((clonemem = sbrk(8192)) == (char*)-1)
+    exit(1);
+  for(i = 0; i < 8192; i++)
+    clonemem[i] = (char)(uint64)arg;
+  exit(0);
+}
+
+void
+clonetest(char *s)
+{
+  int tid, i;
+
+  if((tid = thread_create(cloneworker, (void*)7)) < 0){
+    printf("%s: thread_create failed\n", s);
+    exit(1);
+  }
+  if(thread_join(tid) < 0){
+    printf("%s: thread_join failed\n", s);
+    exit(1);
+  }
+  if(clonepid != tid || clonemem == 0 || clonemem == (char*)-1){
+    printf("%s: thread did not run in shared memory\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 8192; i++){
+    if(clonemem[i] != 7){
+      printf("%s: wrong byte %d\n", s, clonemem[i]);
+      exit(1);
+    }
+  }
+  if(sbrk(-8192) == (char*)-1){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+}
+
+void
+clonequit(void *arg)
+{
+  exit(0);
+}
+
+// threads joined in the reverse of the order they exit in.
+void
+clonejoin(char *s)
+{
+  int tid[4], i;
+
+  for(i = 0; i < 4; i++){
+    if((tid[i] = thread_create(clonequit, 0)) < 0){
+      printf("%s: thread_create failed\n", s);
+      exit(1);
+    }
+    sleep(1);
+  }
+  for(i = 3; i >= 0; i--){
+    if(thread_join(tid[i]) < 0){
+      printf("%s: thread_join(%d) failed\n", s, tid[i]);
+      exit(1);
+    }
+  }
+  if(thread_join(tid[0]) == 0){
+    printf("%s: joined a thread twice\n", s);
+    exit(1);
+  }
+}
+
+// futex_wait() and futex_wake() on a word in a MAP_SHARED page
+// that a forked child shares.
+void
+futextest(char *s)
+{
+  int fd, pid, xstatus;
+  int *w;
+  char buf[PGSIZE];
+
+  unlink("futex.dat");
+  if((fd = open("futex.dat", O_CREATE|O_RDWR)) < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  memset(buf, 0, sizeof(buf));
+  if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+    printf("%s: write failed\n", s);
+    exit(1);
+  }
+  w = mmap(0, PGSIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  unlink("futex.dat");
+  if(w == (int*)-1){
+    printf("%s: mmap failed\n", s);
+    exit(1);
+  }
+  // map the page now, so that fork() shares it.
+  *w = 0;
+  if(futex_wait(w, 1) != -1){
+    printf("%s: futex_wait on a changed word slept\n", s);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    while(*(volatile int*)w == 0)
+      futex_wait(w, 0);
+    exit(*w == 1 ? 0 : 1);
+  }
+  sleep(2);
+  *w = 1;
+  futex_wake(w, 1);
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: child saw the wrong value\n", s);
+    exit(1);
+  }
+  munmap(w, PGSIZE);
+}
+
+// getprocinfo() reports this process, its system calls, and
+// a child that spends its time computing.
+void
+procinfotest(char *s)
+{
+  static struct procinfo pi[NPROC];
+  int n, i, pid, fds[2], me, child;
+  volatile int x;
+  char c;
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(x = 0; x < 20000000; x++)
+      ;
+    write(fds[1], "x", 1);
+    read(fds[0], &c, 1);
+    exit(0);
+  }
+  if(read(fds[0], &c, 1) != 1){
+    printf("%s: read failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 10; i++)
+    getpid();
+  n = getprocinfo(pi, NPROC);
+  me = child = -1;
+  for(i = 0; i < n; i++){
+    if(pi[i].pid == getpid())
+      me = i;
+    if(pi[i].pid == pid)
+      child = i;
+  }
+  write(fds[1], "x", 1);
+  wait(0);
+  if(me < 0 || child < 0){
+    printf("%s: processes missing\n", s);
+    exit(1);
+  }
+  if(pi[me].nsyscall < 10 || pi[me].state != 4){   // RUNNING
+    printf("%s: %d syscalls, state %d\n", s, pi[me].nsyscall, pi[me].state);
+    exit(1);
+  }
+  if(pi[child].ppid != getpid() || pi[child].utime == 0){
+    printf("%s: child ppid %d user time %l\n", s, pi[child].ppid, pi[child].utime);
+    exit(1);
+  }
+}
+
+// syscallstat() counts every system call, and its latency.
+void
+syscallstattest(char *s)
+{
+  static struct scstat before[SYS_getpid+1], after[SYS_getpid+1];
+  int i, b;
+  uint n;
+
+  if(syscallstat(before, SYS_getpid+1) <= SYS_getpid){
+    printf("%s: syscallstat failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 100; i++)
+    getpid();
+  syscallstat(after, SYS_getpid+1);
+  if(after[SYS_getpid].count - before[SYS_getpid].count < 100){
+    printf("%s: %d getpid calls counted\n", s,
+           (int)(after[SYS_getpid].count - before[SYS_getpid].count));
+    exit(1);
+  }
+  n = 0;
+  for(b = 0; b < NSCBUCKET; b++)
+    n += after[SYS_getpid].hist[b] - before[SYS_getpid].hist[b];
+  if(n < 100){
+    printf("%s: histogram holds %d getpid calls\n", s, n);
+    exit(1);
+  }
+}
+
+// user space may read the cycle and instret counters, and
+// perfinfo() charges a child's counts to its parent when the
+// parent waits for it.
+void
+perftest(char *s)
+{
+  struct perfinfo before, after;
+  uint64 c0, i0, c1, i1;
+  volatile int x;
+  int pid;
+
+  asm volatile("csrr %0, cycle" : "=r" (c0));
+  asm volatile("csrr %0, instret" : "=r" (i0));
+  for(x = 0; x < 100000; x++)
+    ;
+  asm volatile("csrr %0, cycle" : "=r" (c1));
+  asm volatile("csrr %0, instret" : "=r" (i1));
+  if(c1 <= c0 || i1 - i0 < 100000){
+    printf("%s: counters did not advance\n", s);
+    exit(1);
+  }
+
+  if(perfinfo(0, &before) < 0){
+    printf("%s: perfinfo failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(x = 0; x < 1000000; x++)
+      ;
+    exit(0);
+  }
+  wait(0);
+  perfinfo(0, &after);
+  if(after.cuinstret - before.cuinstret < 1000000 ||
+     after.cinstret < after.cuinstret || after.instret == 0){
+    printf("%s: child instructions %l\n", s, after.cuinstret - before.cuinstret);
+    exit(1);
+  }
+  if(perfinfo(pid, &after) >= 0){
+    printf("%s: perfinfo of a reaped child succeeded\n", s);
+    exit(1);
+  }
+}
+
+// kernel printf()s go to the kernel log, which the klog
+// device reads back; exec() logs one.
+void
+klogtest(char *s)
+{
+  static char log[1024];
+  char *argv[] = { "echo", 0 };
+  int fd, n, pid, i, found;
+
+  if((fd = open("klog", O_RDONLY)) < 0){
+    printf("%s: cannot open klog\n", s);
+    exit(1);
+  }
+  while(read(fd, log, sizeof(log)) > 0)
+    ;
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    exec("echo", argv);
+    exit(1);
+  }
+  wait(0);
+  found = 0;
+  while((n = read(fd, log, sizeof(log) - 1)) > 0){
+    log[n] = 0;
+    for(i = 0; i + 5 <= n; i++)
+      if(memcmp(log + i, "exec\n", 5) == 0)
+        found = 1;
+  }
+  close(fd);
+  if(!found){
+    printf("%s: exec's message not in the log\n", s);
+    exit(1);
+  }
+}
+
+// printf's %l prints all 64 bits.
+void
+printftest(char *s)
+{
+  char out[32];
+  int fds[2], n;
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  fprintf(fds[1], "%l %l", (1L << 33) + 5, 0xffffffffffffffffL);
+  close(fds[1]);
+  n = read(fds[0], out, sizeof(out) - 1);
+  close(fds[0]);
+  if(n < 0)
+    n = 0;
+  out[n] = 0;
+  if(strcmp(out, "8589934597 18446744073709551615") != 0){
+    printf("%s: printed \"%s\"\n", s, out);
+    exit(1);
+  }
+}
+
+// a command that sh runs from a script on its standard input
+// reads on from where sh left off.
+void
+shstdin(char *s)
+{
+  static char out[64];
+  char *script = "cat\nhello from the script\n";
+  char *argv[] = { "sh", 0 };
+  int fd, n, xstatus;
+
+  fd = open("shstdin.sh", O_CREATE|O_TRUNC|O_WRONLY);
+  if(fd < 0 || write(fd, script, strlen(script)) != strlen(script)){
+    printf("%s: cannot write script\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  if(fork() == 0){
+    close(0);
+    if(open("shstdin.sh", O_RDONLY) != 0)
+      exit(1);
+    close(1);
+    if(open("shstdin.out", O_CREATE|O_TRUNC|O_WRONLY) != 1)
+      exit(1);
+    close(2);
+    if(open("shstdin.err", O_CREATE|O_TRUNC|O_WRONLY) != 2)   // prompts
+      exit(1);
+    exec("sh", argv);
+    exit(1);
+  }
+  wait(&xstatus);
+
+  fd = open("shstdin.out", O_RDONLY);
+  n = fd < 0 ? -1 : read(fd, out, sizeof(out) - 1);
+  close(fd);
+  unlink("shstdin.sh");
+  unlink("shstdin.out");
+  unlink("shstdin.err");
+  if(xstatus != 0){
+    printf("%s: sh failed\n", s);
+    exit(1);
+  }
+  if(n < 0)
+    n = 0;
+  out[n] = 0;
+  if(strcmp(out, "hello from the script\n") != 0){
+    printf("%s: cat printed \"%s\"\n", s, out);
+    exit(1);
+  }
+}
+
 // simple fork and pipe read/write
 
 void
@@ -1777,6 +2201,53 @@ bigfile(char *s)
   unlink("bigfile.dat");
 }
 
+// overwrite part of a file whose pages are cached, straddling
+// a page boundary, and read it back.
+void
+rewrite(char *s)
+{
+  enum { SZ = 3*4096, OFF = 4096-50, N = 100 };
+  int fd, i;
+
+  unlink("rewrite.dat");
+  fd = open("rewrite.dat", O_CREATE | O_RDWR);
+  memset(buf, 'a', SZ);
+  if(fd < 0 || write(fd, buf, SZ) != SZ){
+    printf("%s: create rewrite.dat failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  // read it in, then overwrite through a second descriptor.
+  fd = open("rewrite.dat", O_RDWR);
+  if(fd < 0 || read(fd, buf, SZ) != SZ){
+    printf("%s: read rewrite.dat failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  fd = open("rewrite.dat", O_RDWR);
+  memset(buf, 'b', N);
+  if(fd < 0 || read(fd, buf+N, OFF) != OFF || write(fd, buf, N) != N){
+    printf("%s: rewrite failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  fd = open("rewrite.dat", O_RDONLY);
+  if(fd < 0 || read(fd, buf, SZ) != SZ){
+    printf("%s: read back rewrite.dat failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  for(i = 0; i < SZ; i++){
+    if(buf[i] != (i >= OFF && i < OFF+N ? 'b' : 'a')){
+      printf("%s: rewrite.dat byte %d is %d\n", s, i, buf[i]);
+      exit(1);
+    }
+  }
+  unlink("rewrite.dat");
+}
+
 void
 fourteen(char *s)
 {
@@ -2116,6 +2587,56 @@ sbrkmuch(char *s)
   }
 }
 
+// shrink the heap a page at a time from inside a megapage:
+// the megapage is split, and each page freed on its own.
+void
+sbrkmega(char *s)
+{
+  char *oldbrk, *a, *p;
+  int i;
+
+  oldbrk = sbrk(0);
+  // start the new memory on a megapage boundary, so that
+  // the growth below can be mapped with megapages.
+  a = (char*)MEGAPGROUNDUP((uint64)oldbrk);
+  if(sbrk(a - oldbrk) == (char*)-1 || sbrk(2*MEGAPGSIZE) != a){
+    printf("%s: sbrk grow failed\n", s);
+    exit(1);
+  }
+  for(p = a; p < a + 2*MEGAPGSIZE; p += PGSIZE)
+    *(int*)p = (p - a) / PGSIZE;
+
+  // down into the middle of the second megapage.
+  for(i = 0; i < MEGAPGSIZE / PGSIZE / 2 + 3; i++){
+    if(sbrk(-PGSIZE) == (char*)-1){
+      printf("%s: sbrk(-PGSIZE) failed\n", s);
+      exit(1);
+    }
+  }
+  for(p = a; p < (char*)sbrk(0); p += PGSIZE){
+    if(*(int*)p != (p - a) / PGSIZE){
+      printf("%s: page %d holds %d\n", s, (int)((p - a) / PGSIZE), *(int*)p);
+      exit(1);
+    }
+  }
+  // and grow back over the freed pages.
+  p = sbrk(0);
+  if(sbrk(a + 2*MEGAPGSIZE - p) != p){
+    printf("%s: sbrk regrow failed\n", s);
+    exit(1);
+  }
+  for(; p < a + 2*MEGAPGSIZE; p += PGSIZE){
+    if(*(int*)p != 0){
+      printf("%s: regrown page not zero\n", s);
+      exit(1);
+    }
+  }
+  if(sbrk(oldbrk - (char*)sbrk(0)) == (char*)-1){
+    printf("%s: sbrk shrink failed\n", s);
+    exit(1);
+  }
+}
+
 // can we read the kernel's memory?
 void
 kernmem(char *s)
@@ -2300,14 +2821,38 @@ void
 bigargtest(char *s)
 {
   int pid, fd, xstatus;
+  static char *args[MAXARG];
+  static char zeros[400], big[5000];
+  int i;
+
+  // arguments that fill several stack pages should work.
+  pid = fork();
+  if(pid == 0){
+    memset(zeros, '0', sizeof(zeros)-1);
+    args[0] = "kill";
+    for(i = 1; i < MAXARG-1; i++)
+      args[i] = zeros;      // kill(0) is a no-op
+    args[MAXARG-1] = 0;
+    exec("kill", args);
+    printf("%s: bigargtest: exec with %d-byte arguments failed\n",
+           s, (MAXARG-1) * (int)sizeof(zeros));
+    exit(1);
+  } else if(pid < 0){
+    printf("%s: bigargtest: fork failed\n", s);
+    exit(1);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(xstatus);
 
+  // but not beyond the kernel's limit.
   unlink("bigarg-ok");
   pid = fork();
   if(pid == 0){
-    static char *args[MAXARG];
-    int i;
+    memset(big, ' ', sizeof(big)-1);
+    memmove(big, "bigargs test: failed\n", 21);
     for(i = 0; i < MAXARG-1; i++)
-      args[i] = "bigargs test: failed\n                                                                                                                                                                                                       ";
+      args[i] = big;
     args[MAXARG-1] = 0;
     exec("echo", args);
     fd = open("bigarg-ok", O_CREATE);
@@ -2592,6 +3137,16 @@ struct test {
   {createtest, "createtest"},
   {dirtest, "dirtest"},
   {exectest, "exectest"},
+  {spawntest, "spawntest"},
+  {clonetest, "clonetest"},
+  {clonejoin, "clonejoin"},
+  {futextest, "futextest"},
+  {procinfotest, "procinfotest"},
+  {syscallstattest, "syscallstattest"},
+  {perftest, "perftest"},
+  {printftest, "printftest"},
+  {shstdin, "shstdin"},
+  {klogtest, "klogtest"},
   {pipe1, "pipe1"},
   {killstatus, "killstatus"},
   {preempt, "preempt"},
@@ -2612,6 +3167,7 @@ struct test {
   {subdir, "subdir"},
   {bigwrite, "bigwrite"},
   {bigfile, "bigfile"},
+  {rewrite, "rewrite"},
   {fourteen, "fourteen"},
   {rmdot, "rmdot"},
   {dirfile, "dirfile"},
@@ -2619,6 +3175,7 @@ struct test {
   {forktest, "forktest"},
   {sbrkbasic, "sbrkbasic"},
   {sbrkmuch, "sbrkmuch"},
+  {sbrkmega, "sbrkmega"},
   {kernmem, "kernmem"},
   {MAXVAplus, "MAXVAplus"},
   {sbrkfail, "sbrkfail"},
@@ -6,17 +6,20 @@ print "# generated by usys.pl - do not edit\n";
 
 print "#include \"kernel/syscall.h\"\n";
 
+# entry(name) makes a stub called name; entry(name, label)
+# calls it label instead, for a wrapper in ulib.c to call.
 sub entry {
     my $name = shift;
-    print ".global $name\n";
-    print "${name}:\n";
+    my $label = shift || $name;
+    print ".global $label\n";
+    print "${label}:\n";
     print " li a7, SYS_${name}\n";
     print " ecall\n";
     print " ret\n";
 }
 	
 entry("fork");
-entry("exit");
+entry("exit", "_exit");
 entry("wait");
 entry("pipe");
 entry("read");
@@ -36,5 +39,18 @@ entry("getpid");
 entry("sbrk");
 entry("sleep");
 entry("uptime");
+entry("mmap");
+entry("munmap");
+entry("wsinfo");
+entry("spawn");
+entry("clone");
+entry("futex_wait");
+entry("futex_wake");
+entry("getprocinfo");
+entry("profile");
+entry("tracemask");
+entry("trace");
+entry("syscallstat");
+entry("perfinfo");
 entry("connect");
 entry("pgaccess");
@@ -0,0 +1,45 @@
+// Compare asking the kernel with a system call against
+// reading the USYSCALL page, for the pid and the uptime.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define N 100000
+
+int
+main(int argc, char *argv[])
+{
+  uint64 t0, t1, t2;
+  int i, x;
+
+  x = 0;
+  t0 = uruntime();
+  for(i = 0; i < N; i++)
+    x += getpid();
+  t1 = uruntime();
+  for(i = 0; i < N; i++)
+    x -= ugetpid();
+  t2 = uruntime();
+  if(x != 0){
+    printf("vdsobench: ugetpid disagrees with getpid\n");
+    exit(1);
+  }
+  printf("getpid: syscall %d us, page %d us for %d calls\n",
+         (int)(t1 - t0), (int)(t2 - t1), N);
+
+  t0 = uruntime();
+  for(i = 0; i < N; i++)
+    x = uptime();
+  t1 = uruntime();
+  for(i = 0; i < N; i++)
+    if(uuptime() < x){
+      printf("vdsobench: uuptime went backwards\n");
+      exit(1);
+    }
+  t2 = uruntime();
+  printf("uptime: syscall %d us, page %d us for %d calls\n",
+         (int)(t1 - t0), (int)(t2 - t1), N);
+  printf("vdsobench: cpu %d, ran %d ms\n", ugetcpu(), (int)(uruntime() / 1000));
+  exit(0);
+}